@@ -16,23 +16,424 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include "bch.h"
+#include "gfbulk.h"
+#include "scratcharena.h"
 
-BCH::BCH(const GaloisField& gf, uint32_t err_correctors): gf_(gf), t_(err_correctors) {
+//Field helpers working on raw log/anti log tables. The anti log table is doubled, so no modulo is needed.
+static inline uint16_t gf_mul_(const uint16_t* log, const uint16_t* anti_log, uint16_t a, uint16_t b) {
+    if(!a || !b) {
+        return 0;
+    }
+    return anti_log[log[a - 1] + log[b - 1]];
+}
+
+static inline uint16_t gf_div_(const uint16_t* log, const uint16_t* anti_log, uint32_t order, uint16_t a, uint16_t b) {
+    if(!a) {
+        return 0;
+    }
+    return anti_log[log[a - 1] + order - log[b - 1]];
+}
+
+//syndromes[j] += alpha^(j * position) for the odd j in [1, syndrome_count].
+static inline void add_syndromes_(const uint16_t* anti_log, uint32_t order, uint32_t syndrome_count, uint32_t position,
+                                  uint16_t* syndromes) {
+    uint32_t exponent = position;
+    uint32_t step = (2 * position) % order;
+    for(uint32_t j = 1; j <= syndrome_count; j += 2) {
+        syndromes[j] ^= anti_log[exponent];
+        exponent += step;
+        if(exponent >= order) {
+            exponent -= order;
+        }
+    }
+}
+
+//Groups of fewer messages than this are encoded one at a time by encode_batch: slicing, running and unslicing a
+//whole 256 lane group costs about as much as encoding 64 messages one by one.
+static const std::size_t encode_batch_threshold_ = 64;
+
+//Same for decode_batch, where the bit sliced remainder already pays off from about 8 words.
+static const std::size_t decode_batch_threshold_ = 8;
+
+//Bit sliced helpers. A plane holds the same bit position of up to 256 words, 64 of them per lane word.
+static const uint32_t lanes_ = 64;
+static const uint32_t plane_words_ = 4;
+
+struct plane_ {
+    uint64_t lane[plane_words_];
+};
+
+//Transposes a 64x64 bit matrix in place: bit c of rows[r] is exchanged with bit r of rows[c].
+static void transpose64_(uint64_t* rows) {
+    uint64_t mask = 0x00000000FFFFFFFFull;
+    for(uint32_t j = 32; j; j >>= 1, mask ^= mask << j) {
+        for(uint32_t k = 0; k < lanes_; k = ((k | j) + 1) & ~j) {
+            uint64_t t = ((rows[k] >> j) ^ rows[k | j]) & mask;
+            rows[k] ^= t << j;
+            rows[k | j] ^= t;
+        }
+    }
+}
+
+//Bits [64 * index, 64 * index + 64) of a polynomial stored in size bytes, most significant byte first.
+static uint64_t load_word_(const uint8_t* bytes, uint32_t size, uint32_t index) {
+    uint64_t ret = 0;
+    for(uint32_t i = 0, pos = 8 * index; i < 8 && pos < size; ++i, ++pos) {
+        ret |= uint64_t(bytes[size - 1 - pos]) << (8 * i);
+    }
+    return ret;
+}
+
+static void store_word_(uint8_t* bytes, uint32_t size, uint32_t index, uint64_t word) {
+    for(uint32_t i = 0, pos = 8 * index; i < 8 && pos < size; ++i, ++pos) {
+        bytes[size - 1 - pos] = uint8_t(word >> (8 * i));
+    }
+}
+
+//planes[p] = bit p of each of the count words, which are size bytes apart. Only bits below bits are kept.
+static void slice_(const uint8_t* words, std::size_t count, uint32_t size, uint32_t bits, plane_* planes) {
+    uint64_t rows[lanes_];
+    for(uint32_t s = 0; s < plane_words_; ++s) {
+        if(lanes_ * s >= count) {
+            for(uint32_t p = 0; p < bits; ++p) {
+                planes[p].lane[s] = 0;
+            }
+            continue;
+        }
+        for(uint32_t w = 0; lanes_ * w < bits; ++w) {
+            for(uint32_t i = 0; i < lanes_; ++i) {
+                std::size_t word = lanes_ * s + i;
+                rows[i] = word < count ? load_word_(words + word * size, size, w) : 0;
+            }
+            transpose64_(rows);
+            for(uint32_t q = 0; q < lanes_ && lanes_ * w + q < bits; ++q) {
+                planes[lanes_ * w + q].lane[s] = rows[q];
+            }
+        }
+    }
+}
+
+//Inverse of slice_.
+static void unslice_(const plane_* planes, uint32_t bits, std::size_t count, uint32_t size, uint8_t* words) {
+    uint64_t rows[lanes_];
+    for(uint32_t s = 0; s < plane_words_ && lanes_ * s < count; ++s) {
+        for(uint32_t w = 0; lanes_ * w < bits; ++w) {
+            for(uint32_t q = 0; q < lanes_; ++q) {
+                rows[q] = lanes_ * w + q < bits ? planes[lanes_ * w + q].lane[s] : 0;
+            }
+            transpose64_(rows);
+            for(uint32_t i = 0; i < lanes_ && lanes_ * s + i < count; ++i) {
+                store_word_(words + (lanes_ * s + i) * size, size, w, rows[i]);
+            }
+        }
+    }
+}
+
+static inline void xor_plane_(plane_& dst, const plane_& src) {
+    for(uint32_t i = 0; i < plane_words_; ++i) {
+        dst.lane[i] ^= src.lane[i];
+    }
+}
+
+//Bit sliced LFSR: state[i] = bit i of (m * x^degree) mod g for every lane, where planes[j] holds bit j of m.
+//taps are the exponents below degree where g has a nonzero coefficient, sorted. ring needs degree planes.
+static void lfsr_remainder_(const plane_* planes, uint32_t bits, const uint32_t* taps, uint32_t tap_count,
+                            uint32_t degree, plane_* ring, plane_* state) {
+    if(!degree) {
+        return;
+    }
+    //The register is rotated instead of shifted: logical cell i lives at ring[(head + i) % degree].
+    std::fill(ring, ring + degree, plane_());
+    uint32_t head = 0;
+    for(uint32_t j = bits; j-- > 0; ) {
+        head = head ? head - 1 : degree - 1;
+        plane_ feedback = ring[head];
+        xor_plane_(feedback, planes[j]);
+        ring[head] = plane_();
+        //Taps that wrap around the end of the ring come last.
+        uint32_t i = 0;
+        for(; i < tap_count && taps[i] < degree - head; ++i) {
+            xor_plane_(ring[head + taps[i]], feedback);
+        }
+        for(; i < tap_count; ++i) {
+            xor_plane_(ring[head + taps[i] - degree], feedback);
+        }
+    }
+    for(uint32_t i = 0; i < degree; ++i) {
+        uint32_t cell = head + i;
+        state[i] = ring[cell < degree ? cell : cell - degree];
+    }
+}
+
+BCH::BCH(const GaloisField& gf, uint32_t err_correctors, uint32_t length): gf_(gf), t_(err_correctors), length_(length) {
+    if(!length_) {
+        length_ = (1u << gf_.size()) - 1;
+    }
     do_set_num_errors_();
 }
 
 BitVector BCH::encode(const BitVector& message) const {
+    ScratchArena::Scope scratch;
     BitVector tmp(message);
-    tmp <<= generator_polynomial_.msb(nullptr);
-    BitVector remainder = long_division(tmp, generator_polynomial_).r;
-    remainder ^= tmp;
-    return remainder;
+    tmp <<= polynomials_->generator.msb(nullptr);
+    tmp ^= polynomials_->remainder_table.shifted_remainder(message);
+    return tmp.detached();
+}
+
+void BCH::encode_batch(const uint8_t* messages, std::size_t count, uint8_t* codewords, uint8_t* err) const {
+    const uint32_t degree = generator_order();
+    const uint32_t length = code_length();
+    const uint32_t bits = message_length();
+    const uint32_t message_size = (bits + 7) / 8;
+    const uint32_t codeword_size = (length + 7) / 8;
+    if(err) {
+        *err = !*this;
+    }
+    if(!*this) {
+        std::fill(codewords, codewords + count * codeword_size, 0);
+        return;
+    }
+    ScratchArena::Scope scratch;
+    ScratchBuffer<uint32_t> taps(degree + 1);
+    uint32_t tap_count = 0;
+    polynomials_->generator.for_each_set_bit([&](uint32_t i) {
+        if(i < degree) {
+            taps[tap_count++] = i;
+        }
+    });
+    //planes[0, degree) receive the parity bits, planes[degree, length) the message bits.
+    ScratchBuffer<plane_> planes(length), ring(degree + 1);
+    for(std::size_t first = 0; first < count; first += lanes_ * plane_words_) {
+        std::size_t group = std::min<std::size_t>(lanes_ * plane_words_, count - first);
+        if(group < encode_batch_threshold_) {
+            for(std::size_t i = first; i < first + group; ++i) {
+                const uint8_t* message = messages + i * message_size;
+                BitVector codeword = encode(BitVector(message, message + message_size));
+                //Bytes of the codeword above codeword_size are zero, and it may have fewer.
+                uint32_t bytes = std::min<uint32_t>(codeword.end() - codeword.begin(), codeword_size);
+                uint8_t* out = codewords + i * codeword_size;
+                std::fill(out, out + codeword_size - bytes, 0);
+                std::copy(codeword.end() - bytes, codeword.end(), out + codeword_size - bytes);
+            }
+            continue;
+        }
+        slice_(messages + first * message_size, group, message_size, bits, planes.data() + degree);
+        lfsr_remainder_(planes.data() + degree, bits, taps.data(), tap_count, degree, ring.data(), planes.data());
+        unslice_(planes.data(), length, group, codeword_size, codewords + first * codeword_size);
+    }
+}
+
+void BCH::decode_batch(const uint8_t* received, std::size_t count, uint8_t* corrected, uint8_t* errors) const {
+    const uint16_t* anti_log = gf_.anti_log_table();
+    const uint32_t order = (1u << gf_.size()) - 1;
+    const uint32_t length = code_length();
+    const uint32_t degree = generator_order();
+    const uint32_t codeword_size = (length + 7) / 8;
+    std::copy(received, received + count * codeword_size, corrected);
+    if(errors) {
+        std::fill(errors, errors + count, !*this);
+    }
+    //A code without parity bits (t = 0) has nothing to correct.
+    if(!*this || !degree) {
+        return;
+    }
+    ScratchArena::Scope scratch;
+    ScratchBuffer<uint16_t> syndromes(2 * t_ + 1);
+    ScratchBuffer<uint32_t> positions(t_ + 1);
+    ScratchBuffer<uint32_t> taps(degree + 1);
+    uint32_t tap_count = 0;
+    polynomials_->generator.for_each_set_bit([&](uint32_t i) {
+        if(i < degree) {
+            taps[tap_count++] = i;
+        }
+    });
+    //The syndromes of a word only depend on its remainder modulo the generator, which has just degree bits.
+    //The bit sliced LFSR finds that remainder for a whole group at once, which is all the work clean words need.
+    //Words with a nonzero remainder then get their syndromes from its few set bits, one at a time.
+    ScratchBuffer<plane_> planes(length), ring(degree + 1), remainder(degree + 1);
+    for(std::size_t first = 0; first < count; first += lanes_ * plane_words_) {
+        std::size_t group = std::min<std::size_t>(lanes_ * plane_words_, count - first);
+        if(group < decode_batch_threshold_) {
+            for(std::size_t word = first; word < first + group; ++word) {
+                const uint8_t* bytes = received + word * codeword_size;
+                std::fill(syndromes.data(), syndromes.data() + 2 * t_ + 1, 0);
+                for(uint32_t b = 0; b < codeword_size; ++b) {
+                    for(uint32_t byte = bytes[codeword_size - 1 - b]; byte; byte &= byte - 1) {
+                        uint32_t position = 8 * b + __builtin_ctz(byte);
+                        if(position < length) {
+                            add_syndromes_(anti_log, order, 2 * t_, position, syndromes.data());
+                        }
+                    }
+                }
+                if(!correct_(syndromes.data(), positions.data(), corrected + word * codeword_size) && errors) {
+                    errors[word] = 1;
+                }
+            }
+            continue;
+        }
+        slice_(received + first * codeword_size, group, codeword_size, length, planes.data());
+        //received mod g = (high part * x^degree) mod g + low part.
+        lfsr_remainder_(planes.data() + degree, length - degree, taps.data(), tap_count, degree, ring.data(), remainder.data());
+        plane_ pending = plane_();
+        for(uint32_t p = 0; p < degree; ++p) {
+            xor_plane_(planes[p], remainder[p]);
+            for(uint32_t s = 0; s < plane_words_; ++s) {
+                pending.lane[s] |= planes[p].lane[s];
+            }
+        }
+        for(uint32_t s = 0; s < plane_words_; ++s) {
+            for(uint64_t lanes = pending.lane[s]; lanes; lanes &= lanes - 1) {
+                uint32_t lane = __builtin_ctzll(lanes);
+                std::size_t word = first + lanes_ * s + lane;
+                std::fill(syndromes.data(), syndromes.data() + 2 * t_ + 1, 0);
+                for(uint32_t p = 0; p < degree; ++p) {
+                    if((planes[p].lane[s] >> lane) & 1) {
+                        add_syndromes_(anti_log, order, 2 * t_, p, syndromes.data());
+                    }
+                }
+                if(!correct_(syndromes.data(), positions.data(), corrected + word * codeword_size) && errors) {
+                    errors[word] = 1;
+                }
+            }
+        }
+    }
+}
+
+bool BCH::correct_(uint16_t* syndromes, uint32_t* positions, uint8_t* codeword) const {
+    const uint32_t codeword_size = (code_length() + 7) / 8;
+    bool has_errors = false;
+    for(uint32_t j = 1; j <= 2 * t_; j += 2) {
+        has_errors = has_errors || syndromes[j];
+    }
+    if(!has_errors) {
+        return true;
+    }
+    uint8_t failed = 0;
+    uint32_t found = locate_errors_(syndromes, positions, &failed);
+    if(failed) {
+        return false;
+    }
+    for(uint32_t i = 0; i < found; ++i) {
+        codeword[codeword_size - 1 - positions[i] / 8] ^= 1 << (positions[i] % 8);
+    }
+    return true;
 }
 
-BitVector BCH::decode(const BitVector& message) const {
-    //TODO
-    return BitVector();
+BitVector BCH::decode(const BitVector& message, uint8_t* err) const {
+    const uint16_t* anti_log = gf_.anti_log_table();
+    const uint32_t order = (1 << gf_.size()) - 1;
+    const uint32_t syndrome_count = 2 * t_;
+    if(err) {
+        *err = 0;
+    }
+    ScratchArena::Scope scratch;
+    //syndromes[j] = r(alpha^j), j in [1, 2t]. Only odd ones are computed directly since S(2j) = S(j)^2.
+    ScratchBuffer<uint16_t> syndromes(syndrome_count + 1, 0);
+    bool has_errors = false;
+    const uint32_t length = code_length();
+    message.for_each_set_bit([&](uint32_t position) {
+        if(position >= length) {
+            return;
+        }
+        add_syndromes_(anti_log, order, syndrome_count, position, syndromes.data());
+    });
+    for(uint32_t j = 1; j <= syndrome_count; j += 2) {
+        has_errors = has_errors || syndromes[j];
+    }
+    if(!has_errors) {
+        return message.detached();
+    }
+    ScratchBuffer<uint32_t> positions(t_ + 1);
+    uint8_t failed = 0;
+    uint32_t found = locate_errors_(syndromes.data(), positions.data(), &failed);
+    if(failed) {
+        if(err) {
+            *err = 1;
+        }
+        return message.detached();
+    }
+    BitVector ret(message);
+    for(uint32_t i = 0; i < found; ++i) {
+        //Bits past the end of a short message are zeros that were flipped.
+        if(positions[i] < ret.size()) {
+            ret.flip(positions[i]);
+        }
+        else {
+            ret[positions[i]] = true;
+        }
+    }
+    return ret.detached();
+}
+
+uint32_t BCH::locate_errors_(uint16_t* syndromes, uint32_t* positions, uint8_t* err) const {
+    const uint16_t* log = gf_.log_table();
+    const uint16_t* anti_log = gf_.anti_log_table();
+    const uint32_t order = (1 << gf_.size()) - 1;
+    const uint32_t syndrome_count = 2 * t_;
+    *err = 0;
+    for(uint32_t j = 2; j <= syndrome_count; j += 2) {
+        syndromes[j] = gf_mul_(log, anti_log, syndromes[j / 2], syndromes[j / 2]);
+    }
+    //Berlekamp-Massey: find the error locator polynomial lambda(x) = prod(1 - x * alpha^position).
+    ScratchBuffer<uint16_t> lambda(syndrome_count + 1, 0), previous_buffer(syndrome_count + 1, 0), saved_buffer(syndrome_count + 1);
+    uint16_t* previous = previous_buffer.data();
+    uint16_t* saved = saved_buffer.data();
+    lambda[0] = previous[0] = 1;
+    uint32_t degree = 0, shift = 1;
+    uint16_t previous_discrepancy = 1;
+    for(uint32_t r = 1; r <= syndrome_count; ++r) {
+        uint16_t discrepancy = syndromes[r];
+        for(uint32_t i = 1; i <= degree; ++i) {
+            discrepancy ^= gf_mul_(log, anti_log, lambda[i], syndromes[r - i]);
+        }
+        if(!discrepancy) {
+            ++shift;
+            continue;
+        }
+        uint16_t coefficient = gf_div_(log, anti_log, order, discrepancy, previous_discrepancy);
+        bool grow = 2 * degree < r;
+        if(grow) {
+            for(uint32_t i = 0; i <= syndrome_count; ++i) {
+                saved[i] = lambda[i];
+            }
+        }
+        for(uint32_t i = 0; i + shift <= syndrome_count; ++i) {
+            lambda[i + shift] ^= gf_mul_(log, anti_log, coefficient, previous[i]);
+        }
+        if(grow) {
+            degree = r - degree;
+            uint16_t* swap = previous;
+            previous = saved;
+            saved = swap;
+            previous_discrepancy = discrepancy;
+            shift = 1;
+        }
+        else {
+            ++shift;
+        }
+    }
+    if(degree > t_) {
+        *err = 1;
+        return 0;
+    }
+    //Chien search: position p is in error iff lambda(alpha^-p) = 0. Positions removed by shortening are always
+    //zero, so roots there can't be errors and are left out: the word is then reported as undecodable.
+    const uint32_t length = code_length();
+    ScratchBuffer<uint16_t> values(length);
+    gf_evaluate_powers(gf_, lambda.data(), degree, 0, order - 1, values.data(), length);
+    uint32_t roots = 0;
+    for(uint32_t p = 0; p < length && roots < degree; ++p) {
+        if(!values[p]) {
+            positions[roots++] = p;
+        }
+    }
+    if(roots != degree) {
+        *err = 1;
+        return 0;
+    }
+    return roots;
 }
 
 void BCH::set_num_errors(uint32_t number) {
@@ -41,14 +442,34 @@ void BCH::set_num_errors(uint32_t number) {
 }
 
 void BCH::do_set_num_errors_() {
-    generator_polynomial_ = 1;
-    BitVector polynomial;
-    for(uint32_t i = 0; i < t_; ++i) {
-        polynomial = gf_.minimal_polinomial(1 + (i * 2));
-        multiply(generator_polynomial_, polynomial);
-    }
+    polynomials_ = PolynomialCache::instance().code(gf_, t_);
 }
 
 uint32_t BCH::generator_order() const {
-    return generator_polynomial_.msb();
+    return polynomials_->generator.msb();
+}
+
+const BitVector& BCH::generator_polynomial() const {
+    return polynomials_->generator;
+}
+
+uint32_t BCH::code_length() const {
+    return length_;
+}
+
+uint32_t BCH::field_order() const {
+    return gf_.size();
+}
+
+uint32_t BCH::message_length() const {
+    uint32_t degree = generator_order();
+    return code_length() > degree ? code_length() - degree : 0;
+}
+
+uint32_t BCH::num_errors() const {
+    return t_;
+}
+
+BCH::operator bool() const {
+    return length_ <= (1u << gf_.size()) - 1 && generator_order() < length_;
 }
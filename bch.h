@@ -19,27 +19,68 @@
 #ifndef BCH_H
 #define BCH_H
 
+#include <cstddef>
+#include <memory>
 #include "galoisfield.h"
 #include "bitvector.h"
+#include "polynomialcache.h"
 
 /**
  * @todo write docs
  */
 class BCH {
 public:
-    BCH(const GaloisField& gf, uint32_t err_correctors);
+    /**
+     * length shortens the code to length bits, 2^m - 1 when 0: the top 2^m - 1 - length positions are taken to be
+     * zero and are neither stored nor processed, so messages have length - generator_order() bits.
+     * The code is invalid, see operator bool, if length is above 2^m - 1 or leaves no message bits for t.
+     */
+    BCH(const GaloisField& gf, uint32_t err_correctors, uint32_t length = 0);
     BCH(const BCH&) = default;
     ~BCH() = default;
     BCH& operator=(const BCH&) = default;
     BitVector encode(const BitVector& message) const;
-    BitVector decode(const BitVector& message) const;
+    /**
+     * Encodes count messages at once. Messages are message_length() bits stored in (message_length() + 7) / 8 bytes
+     * each and codewords are code_length() bits stored in (code_length() + 7) / 8 bytes each, both laid out back to back
+     * with the most significant byte first, as BitVector::begin() exports them.
+     * The result of each codeword is the same as encode() on the corresponding message.
+     * If the code is invalid, err is set to 1 and the codewords are zeroed.
+     */
+    void encode_batch(const uint8_t* messages, std::size_t count, uint8_t* codewords, uint8_t* err = nullptr) const;
+    /**
+     * Corrects up to t errors in a received codeword and returns the corrected codeword.
+     * If the word can't be decoded, err is set to 1 and message is returned unchanged.
+     */
+    BitVector decode(const BitVector& message, uint8_t* err = nullptr) const;
+    /**
+     * Decodes count received words of code_length() bits, laid out as the codewords of encode_batch, into corrected.
+     * If errors isn't null, errors[i] is set to 1 when word i can't be decoded, in which case it is copied unchanged.
+     * Every word is undecodable if the code is invalid.
+     */
+    void decode_batch(const uint8_t* received, std::size_t count, uint8_t* corrected, uint8_t* errors = nullptr) const;
     void set_num_errors(uint32_t number);
     uint32_t generator_order() const;
+    const BitVector& generator_polynomial() const;
+    uint32_t code_length() const;
+    uint32_t field_order() const;
+    uint32_t message_length() const;
+    uint32_t num_errors() const;
+    //True if code_length() is at most 2^m - 1 and above generator_order(), so messages have at least one bit.
+    explicit operator bool() const;
 private:
-    BitVector generator_polynomial_;
+    //Shared with every other code of the same (m, t) through PolynomialCache.
+    std::shared_ptr<const PolynomialCache::code_polynomials> polynomials_;
     GaloisField gf_;
     uint32_t t_;
+    uint32_t length_;
     void do_set_num_errors_();
+    //Runs Berlekamp-Massey and Chien search given the odd syndromes[1..2t]; the even ones are filled in.
+    //Returns the number of error positions written to positions, or sets err to 1 if the word can't be decoded.
+    uint32_t locate_errors_(uint16_t* syndromes, uint32_t* positions, uint8_t* err) const;
+    //Corrects a codeword laid out as in decode_batch given its odd syndromes, which are overwritten.
+    //Returns false, leaving it unchanged, if it can't be decoded.
+    bool correct_(uint16_t* syndromes, uint32_t* positions, uint8_t* codeword) const;
 };
 
 #endif // BCH_H
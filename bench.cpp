@@ -0,0 +1,345 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "bitvector.h"
+#include "staticbitvector.h"
+#include "galoisfield.h"
+#include "bch.h"
+#include "polynomialcache.h"
+#include "clmul.h"
+#include "gfbulk.h"
+#include "chacha20.h"
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef EXIT_FAILURE
+#define EXIT_FAILURE 1
+#endif
+
+#ifndef EXIT_SUCCESS
+#define EXIT_SUCCESS 0
+#endif
+
+/**
+ * Self contained microbenchmarks of the arithmetic and coding hot paths.
+ * Each benchmark is run with a doubling number of iterations until one run lasts at least --min_time seconds,
+ * and that run is reported.
+ */
+
+struct result {
+    std::string name;
+    uint64_t iterations;
+    double ns_per_op;
+    double bits_per_second;
+};
+
+struct benchmark {
+    std::string name;
+    //Bits processed by one operation, for the throughput column.
+    uint64_t bits;
+    //Runs the operation the given number of times.
+    std::function<void(uint64_t)> run;
+};
+
+//Keeps the compiler from dropping computations whose results are otherwise unused.
+template<typename T>
+static void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+static void help(std::ostream& os) {
+    os << "Microbenchmarks for BitVector, GaloisField and BCH." << std::endl;
+    os << "--filter || -f" << std::endl;
+    os << "  [optional] only run benchmarks whose name contains this text." << std::endl;
+    os << "--min_time" << std::endl;
+    os << "  [optional] minimum seconds per reported run. Default 0.2." << std::endl;
+    os << "--json" << std::endl;
+    os << "  [optional] print the results as JSON instead of a table." << std::endl;
+}
+
+static std::vector<uint8_t> random_bytes(uint64_t stream, std::size_t bytes) {
+    static const uint32_t key[ChaCha20::key_words] = {0x243F6A88, 0x85A308D3, 0x13198A2E, 0x03707344};
+    std::vector<uint8_t> ret(bytes);
+    ChaCha20(key, stream).fill(ret.data(), ret.size());
+    return ret;
+}
+
+//Random polynomial of exactly bits bits, the top one set.
+static BitVector random_polynomial(uint64_t stream, uint32_t bits) {
+    std::vector<uint8_t> bytes = random_bytes(stream, (bits + 7) / 8);
+    uint32_t top = (bits - 1) % 8;
+    bytes[0] &= (1 << (top + 1)) - 1;
+    bytes[0] |= 1 << top;
+    return BitVector(bytes.begin(), bytes.end());
+}
+
+static std::vector<uint8_t> random_messages(const BCH& code, uint64_t stream, std::size_t count) {
+    uint32_t bits = code.message_length();
+    uint32_t bytes = (bits + 7) / 8;
+    std::vector<uint8_t> ret = random_bytes(stream, bytes * count);
+    for(std::size_t i = 0; i < count && bits % 8; ++i) {
+        ret[i * bytes] &= (1 << (bits % 8)) - 1;
+    }
+    return ret;
+}
+
+//Codewords with t / 2 bit errors each, so the decoders take their full path.
+static std::vector<uint8_t> noisy_codewords(const BCH& code, uint64_t stream, std::size_t count) {
+    uint32_t bytes = (code.code_length() + 7) / 8;
+    std::vector<uint8_t> messages = random_messages(code, stream, count);
+    std::vector<uint8_t> ret(bytes * count);
+    code.encode_batch(messages.data(), count, ret.data());
+    std::vector<uint8_t> positions = random_bytes(stream + 1, 4 * count * (code.num_errors() / 2 + 1));
+    for(std::size_t i = 0, p = 0; i < count; ++i) {
+        for(uint32_t e = 0; e < code.num_errors() / 2; ++e, p += 4) {
+            uint32_t position = (positions[p] | (positions[p + 1] << 8) | (positions[p + 2] << 16)) % code.code_length();
+            ret[i * bytes + bytes - 1 - position / 8] ^= 1 << (position % 8);
+        }
+    }
+    return ret;
+}
+
+static std::vector<benchmark> benchmarks() {
+    std::vector<benchmark> ret;
+    for(uint32_t bits : {64u, 256u, 1024u, 4096u, 16384u}) {
+        BitVector left = random_polynomial(bits, bits), right = random_polynomial(bits + 1, bits);
+        ret.push_back({"multiply/" + std::to_string(bits), 2 * uint64_t(bits), [left, right](uint64_t iterations) {
+            for(uint64_t i = 0; i < iterations; ++i) {
+                keep(multiply(left, right));
+            }
+        }});
+    }
+    for(uint32_t bits : {64u, 256u, 1024u, 4096u}) {
+        BitVector dividend = random_polynomial(2 * bits, 2 * bits), divisor = random_polynomial(2 * bits + 1, bits);
+        ret.push_back({"long_division/" + std::to_string(2 * bits) + "/" + std::to_string(bits), 2 * uint64_t(bits),
+                       [dividend, divisor](uint64_t iterations) {
+            for(uint64_t i = 0; i < iterations; ++i) {
+                keep(long_division(dividend, divisor));
+            }
+        }});
+    }
+    {
+        //Remainder of a 255 bit word by a degree 64 generator, as in encoding a (255, 191) code.
+        StaticBitVector<255> dividend(random_polynomial(300, 255));
+        StaticBitVector<65> divisor(random_polynomial(301, 65));
+        ret.push_back({"static_long_division/255/65", 255, [dividend, divisor](uint64_t iterations) {
+            for(uint64_t i = 0; i < iterations; ++i) {
+                keep(long_division(dividend, divisor));
+            }
+        }});
+        StaticBitVector<256> left(random_polynomial(302, 256)), right(random_polynomial(303, 256));
+        ret.push_back({"static_multiply/256", 512, [left, right](uint64_t iterations) {
+            for(uint64_t i = 0; i < iterations; ++i) {
+                keep(multiply(left, right));
+            }
+        }});
+    }
+    for(uint8_t m : {4, 8, 12, 16}) {
+        GaloisField field(m);
+        std::vector<uint8_t> bytes = random_bytes(100 + m, 2048);
+        std::vector<GaloisField> elements;
+        for(std::size_t i = 0; i < bytes.size(); i += 2) {
+            elements.push_back(GaloisField(m, (bytes[i] | (bytes[i + 1] << 8)) & ((1 << m) - 1)));
+        }
+        ret.push_back({"gf_multiply/" + std::to_string(m), m, [elements](uint64_t iterations) {
+            GaloisField product = elements[0];
+            for(uint64_t i = 0; i < iterations; ++i) {
+                product *= elements[i % elements.size()];
+                product += elements[(i + 1) % elements.size()];
+            }
+            keep(product);
+        }});
+        std::vector<uint16_t> region(4096), out(region.size());
+        for(std::size_t i = 0; i < region.size(); ++i) {
+            region[i] = uint16_t(elements[i % elements.size()]);
+        }
+        ret.push_back({"gf_multiply_region/" + std::to_string(m) + "/4096", uint64_t(m) * region.size(),
+                       [field, region, out](uint64_t iterations) mutable {
+            for(uint64_t i = 0; i < iterations; ++i) {
+                gf_multiply_region(field, region[i % region.size()] | 1, region.data(), out.data(), region.size());
+                keep(out[0]);
+            }
+        }});
+        ret.push_back({"minimal_polinomial/" + std::to_string(m), m, [field](uint64_t iterations) {
+            uint32_t order = (1u << field.size()) - 1;
+            for(uint64_t i = 0; i < iterations; ++i) {
+                keep(field.minimal_polinomial(1 + (2 * i) % order));
+            }
+        }});
+    }
+    const std::size_t batch = 1024;
+    struct code_size {
+        uint8_t m;
+        uint32_t t;
+    };
+    for(code_size size : {code_size{6, 3}, code_size{8, 5}, code_size{8, 10}, code_size{10, 20}, code_size{12, 30},
+                          code_size{16, 10}}) {
+        std::string suffix = std::to_string(size.m) + "/" + std::to_string(size.t);
+        BCH code(GaloisField(size.m), size.t);
+        //Every code is built from scratch: the polynomial cache is emptied first.
+        ret.push_back({"bch_construct/" + suffix, code.code_length(), [size](uint64_t iterations) {
+            for(uint64_t i = 0; i < iterations; ++i) {
+                PolynomialCache::instance().clear();
+                keep(BCH(GaloisField(size.m), size.t));
+            }
+        }});
+        ret.push_back({"bch_construct_cached/" + suffix, code.code_length(), [size](uint64_t iterations) {
+            for(uint64_t i = 0; i < iterations; ++i) {
+                keep(BCH(GaloisField(size.m), size.t));
+            }
+        }});
+        std::vector<uint8_t> messages = random_messages(code, size.m * 100 + size.t, batch);
+        std::vector<uint8_t> received = noisy_codewords(code, size.m * 100 + size.t + 7, batch);
+        uint32_t message_bytes = (code.message_length() + 7) / 8;
+        uint32_t codeword_bytes = (code.code_length() + 7) / 8;
+        std::vector<BitVector> message_vectors, received_vectors;
+        for(std::size_t i = 0; i < batch; ++i) {
+            message_vectors.push_back(BitVector(messages.begin() + i * message_bytes, messages.begin() + (i + 1) * message_bytes));
+            received_vectors.push_back(BitVector(received.begin() + i * codeword_bytes, received.begin() + (i + 1) * codeword_bytes));
+        }
+        ret.push_back({"bch_encode/" + suffix, code.message_length(), [code, message_vectors](uint64_t iterations) {
+            for(uint64_t i = 0; i < iterations; ++i) {
+                keep(code.encode(message_vectors[i % message_vectors.size()]));
+            }
+        }});
+        ret.push_back({"bch_decode/" + suffix, code.code_length(), [code, received_vectors](uint64_t iterations) {
+            for(uint64_t i = 0; i < iterations; ++i) {
+                keep(code.decode(received_vectors[i % received_vectors.size()]));
+            }
+        }});
+        std::vector<uint8_t> codewords(codeword_bytes * batch);
+        ret.push_back({"bch_encode_batch/" + suffix + "/" + std::to_string(batch), code.message_length() * batch,
+                       [code, messages, codewords](uint64_t iterations) mutable {
+            for(uint64_t i = 0; i < iterations; ++i) {
+                code.encode_batch(messages.data(), batch, codewords.data());
+                keep(codewords[0]);
+            }
+        }});
+        ret.push_back({"bch_decode_batch/" + suffix + "/" + std::to_string(batch), code.code_length() * batch,
+                       [code, received, codewords](uint64_t iterations) mutable {
+            for(uint64_t i = 0; i < iterations; ++i) {
+                code.decode_batch(received.data(), batch, codewords.data());
+                keep(codewords[0]);
+            }
+        }});
+    }
+    return ret;
+}
+
+static result measure(const benchmark& bench, double min_time) {
+    typedef std::chrono::steady_clock clock;
+    uint64_t iterations = 1;
+    while(true) {
+        clock::time_point start = clock::now();
+        bench.run(iterations);
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        if(seconds >= min_time || iterations >= (uint64_t(1) << 40)) {
+            double ns = seconds * 1e9 / iterations;
+            return {bench.name, iterations, ns, bench.bits * 1e9 / ns};
+        }
+        //Aim a little past min_time so that the next run is most likely the last one.
+        uint64_t next = seconds > 0 ? uint64_t(iterations * 1.4 * min_time / seconds) : 0;
+        iterations = std::max(2 * iterations, std::min(next, 100 * iterations));
+    }
+}
+
+static std::string escape(const std::string& text) {
+    std::string ret;
+    for(char c : text) {
+        if(c == '"' || c == '\\') {
+            ret += '\\';
+        }
+        ret += c;
+    }
+    return ret;
+}
+
+int main(int argc, char **argv) {
+    std::string filter;
+    double min_time = 0.2;
+    bool json = false;
+    for(int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if(arg == "--filter" || arg == "-f") {
+            if((++i) == argc) {
+                std::cerr << "Missing argument after " << arg << std::endl;
+                return EXIT_FAILURE;
+            }
+            filter = argv[i];
+        }
+        else if(arg == "--min_time") {
+            if((++i) == argc) {
+                std::cerr << "Missing argument after " << arg << std::endl;
+                return EXIT_FAILURE;
+            }
+            char* next;
+            min_time = std::strtod(argv[i], &next);
+            if(*next || min_time <= 0) {
+                std::cerr << "Invalid parsing. " << argv[i] << " is not a valid time." << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if(arg == "--json") {
+            json = true;
+        }
+        else if(arg == "--help" || arg == "-h") {
+            help(std::cout);
+            return EXIT_SUCCESS;
+        }
+        else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            help(std::cerr);
+            return EXIT_FAILURE;
+        }
+    }
+#ifndef NDEBUG
+    std::cerr << "Warning: benchmarking a build without NDEBUG, numbers may not be representative." << std::endl;
+#endif
+    std::vector<result> results;
+    for(const benchmark& bench : benchmarks()) {
+        if(bench.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        results.push_back(measure(bench, min_time));
+        if(!json) {
+            const result& last = results.back();
+            std::cout << last.name << std::string(last.name.size() < 40 ? 40 - last.name.size() : 1, ' ')
+                      << last.ns_per_op << " ns/op  " << last.bits_per_second / 1e6 << " Mbit/s  ("
+                      << last.iterations << " iterations)" << std::endl;
+        }
+    }
+    if(json) {
+        std::cout << "{" << std::endl;
+        std::cout << "  \"context\": {\"clmul\": " << (clmul_hardware_support() ? "true" : "false")
+                  << ", \"min_time\": " << min_time << "}," << std::endl;
+        std::cout << "  \"benchmarks\": [" << std::endl;
+        for(std::size_t i = 0; i < results.size(); ++i) {
+            std::cout << "    {\"name\": \"" << escape(results[i].name) << "\", \"iterations\": " << results[i].iterations
+                      << ", \"ns_per_op\": " << results[i].ns_per_op << ", \"bits_per_second\": " << results[i].bits_per_second
+                      << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+        }
+        std::cout << "  ]" << std::endl;
+        std::cout << "}" << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
@@ -17,32 +17,21 @@
  */
 
 #include "bitvector.h"
+#include "clmul.h"
+#include "scratcharena.h"
+#include <utility>
+#include <vector>
+
+static const uint32_t word_bits_ = sizeof(uint64_t) * 8;
 
 uint32_t BitVector::msb(uint8_t* err) const {
-    if(!buffer_) {
-        if(err) {
-            *err = 1;
-        }
-        return 0;
-    }
-    uint8_t* cur = buffer_;
-    uint32_t base = (sizeof(*buffer_) * 8) * (size_ - 1);
-    uint8_t* end = cur + size_;
-    while(cur != end) {
-        if(*cur) {
-            uint8_t checker = *cur;
-            uint8_t calc = 0;
-            while(checker) {
-                checker >>= 1;
-                ++calc;
-            }
+    for(uint32_t i = word_count_(); i > 0; --i) {
+        if(buffer_[i - 1]) {
             if(err) {
                 *err = 0;
             }
-            return base + calc - 1;
+            return (i - 1) * word_bits_ + (word_bits_ - 1) - __builtin_clzll(buffer_[i - 1]);
         }
-        ++cur;
-        base -= sizeof(*buffer_) * 8;
     }
     if(err) {
         *err = 1;
@@ -57,64 +46,137 @@ static void swap_(T& left, T& right) {
     right = tmp;
 }
 
-BitVector::BitVector(Size size): size_(size.value_), buffer_(size_ ? new uint8_t[size_] : nullptr) {
+static uint64_t* allocate_words_(uint32_t words, bool& from_arena) {
+    ScratchArena* arena = ScratchArena::current();
+    from_arena = arena != nullptr;
+    if(arena) {
+        return static_cast<uint64_t*>(arena->allocate(words * sizeof(uint64_t)));
+    }
+    return new uint64_t[words];
+}
+
+void BitVector::allocate_(uint32_t words) {
+    if(words <= capacity_) {
+        return;
+    }
+    release_();
+    buffer_ = allocate_words_(words, arena_);
+    capacity_ = words;
+}
+
+void BitVector::release_() {
+    if(buffer_ != inline_ && !arena_) {
+        delete[] buffer_;
+    }
+    buffer_ = inline_;
+    capacity_ = inline_words_;
+    arena_ = false;
+}
+
+void BitVector::take_(BitVector& other) {
+    size_ = other.size_;
+    if(other.buffer_ != other.inline_) {
+        buffer_ = other.buffer_;
+        capacity_ = other.capacity_;
+        arena_ = other.arena_;
+    }
+    else {
+        uint32_t words = other.word_count_();
+        for(uint32_t i = 0; i < words; ++i) {
+            inline_[i] = other.inline_[i];
+        }
+    }
+    other.size_ = 0;
+    other.buffer_ = other.inline_;
+    other.capacity_ = inline_words_;
+    other.arena_ = false;
 }
 
-BitVector::BitVector(const BitVector& other): size_(other.size_), buffer_(other.size_ ? new uint8_t[other.size_] : nullptr) {
-    for(uint32_t i = 0; i < size_; ++i) {
+BitVector::BitVector(Size size): size_(size.value_), capacity_(inline_words_), arena_(false), buffer_(inline_) {
+    uint32_t words = word_count_();
+    allocate_(words);
+    for(uint32_t i = 0; i < words; ++i) {
+        buffer_[i] = 0;
+    }
+}
+
+BitVector::BitVector(const BitVector& other): size_(other.size_), capacity_(inline_words_), arena_(false), buffer_(inline_) {
+    uint32_t words = word_count_();
+    allocate_(words);
+    for(uint32_t i = 0; i < words; ++i) {
         buffer_[i] = other.buffer_[i];
     }
 }
 
+BitVector::BitVector(BitVector&& other) noexcept: size_(0), capacity_(inline_words_), arena_(false), buffer_(inline_) {
+    take_(other);
+}
+
 BitVector::~BitVector() {
-    delete[] buffer_;
+    release_();
 }
 
 BitVector& BitVector::operator=(const BitVector& other) {
-    BitVector tmp(other);
-    swap(tmp);
+    if(this == &other) {
+        return *this;
+    }
+    //Reuse our buffer when it is big enough.
+    uint32_t words = other.word_count_();
+    allocate_(words);
+    for(uint32_t i = 0; i < words; ++i) {
+        buffer_[i] = other.buffer_[i];
+    }
+    size_ = other.size_;
     return *this;
 }
 
-BitVector& BitVector::operator&=(const BitVector& other) {
-    uint32_t smaller_size = size_ < other.size_ ? size_ : other.size_;
-    uint8_t* cur = buffer_ + size_ - 1, *cur_other = other.buffer_ + other.size_ - 1;
-    while(smaller_size) {
-        *cur &= *cur_other;
-        --cur;
-        --cur_other;
-        --smaller_size;
-    }
-    uint8_t* end = buffer_ - 1;
-    while(cur != end) {
-        *cur = 0;
-        --cur;
+BitVector& BitVector::operator=(BitVector&& other) noexcept {
+    if(this != &other) {
+        release_();
+        take_(other);
     }
     return *this;
 }
 
-BitVector& BitVector::operator|=(const BitVector& other) {
-    uint32_t bigget_size = size_ > other.size_ ? size_ : other.size_;
-    int32_t diff = bigget_size - size_;
-    if(diff > 0) {
-        uint8_t* new_buffer = new uint8_t[size_ + diff];
-        for(uint32_t  i = 0; i < diff; ++i) {
-            new_buffer[i] = 0;
-        }
-        for(uint32_t i = 0; i < size_; ++i) {
-            new_buffer[i + diff] = buffer_[i];
+void BitVector::grow_(uint32_t bytes) {
+    if(bytes <= size_) {
+        return;
+    }
+    uint32_t old_words = word_count_();
+    uint32_t new_words = words_for_(bytes);
+    if(new_words > capacity_) {
+        //Grow geometrically so setting bits in increasing order doesn't copy on every byte.
+        uint32_t capacity = new_words > 2 * capacity_ ? new_words : 2 * capacity_;
+        bool from_arena = false;
+        uint64_t* new_buffer = allocate_words_(capacity, from_arena);
+        for(uint32_t i = 0; i < old_words; ++i) {
+            new_buffer[i] = buffer_[i];
         }
-        delete[] buffer_;
+        release_();
         buffer_ = new_buffer;
-        size_ += diff;
+        capacity_ = capacity;
+        arena_ = from_arena;
     }
-    uint32_t size_other = other.size_;
-    uint8_t* cur = buffer_ + size_ - 1, *cur_other = other.buffer_ + other.size_ - 1;
-    while(size_other) {
-        *cur |= *cur_other;
-        --cur;
-        --cur_other;
-        --size_other;
+    for(uint32_t i = old_words; i < new_words; ++i) {
+        buffer_[i] = 0;
+    }
+    size_ = bytes;
+}
+
+BitVector& BitVector::operator&=(const BitVector& other) {
+    uint32_t words = word_count_();
+    uint32_t other_words = other.word_count_();
+    for(uint32_t i = 0; i < words; ++i) {
+        buffer_[i] = i < other_words ? buffer_[i] & other.buffer_[i] : 0;
+    }
+    return *this;
+}
+
+BitVector& BitVector::operator|=(const BitVector& other) {
+    grow_(other.size_);
+    uint32_t other_words = other.word_count_();
+    for(uint32_t i = 0; i < other_words; ++i) {
+        buffer_[i] |= other.buffer_[i];
     }
     return *this;
 }
@@ -128,37 +190,28 @@ BitVector& BitVector::operator<<=(uint32_t value) {
     if(bytes_are_zero) {
         return *this;
     }
-    msb_ += 1;
-    int32_t excess = value + msb_ - sizeof(*buffer_) * 8 * size_;
-    uint32_t extend_range = excess > 0 ? (excess + (sizeof(*buffer_) * 8 - 1)) / (sizeof(*buffer_) * 8) : 0;
-    if(extend_range) {
-        uint8_t* new_buffer = new uint8_t[size_ + extend_range];
-        for(uint32_t i = 0; i < extend_range; ++i) {
-            new_buffer[i] = 0;
-        }
-        for(uint32_t i = 0; i < size_; ++i) {
-            new_buffer[i + extend_range] = buffer_[i];
-        }
-        delete[] buffer_;
-        size_ += extend_range;
-        buffer_ = new_buffer;
+    uint32_t used_words = msb_ / word_bits_ + 1;
+    uint64_t needed_bits = static_cast<uint64_t>(msb_) + 1 + value;
+    if(needed_bits > static_cast<uint64_t>(size_) * 8) {
+        grow_(static_cast<uint32_t>((needed_bits + 7) / 8));
     }
-    uint8_t* begin = buffer_ + (size_ - 1) - msb_ / (sizeof(*buffer_) * 8);
-    uint8_t* end = buffer_ + size_;
-    uint32_t bytes_dif = value / 8;
-    uint8_t offset = (value % (sizeof(*buffer_) * 8));
-    uint8_t hi_mask = ~((1 << ((sizeof(*buffer_) * 8 - offset))) - 1);
-    while(begin != end) {
-        uint8_t* dest = begin - bytes_dif;
-        uint8_t cur_val = *begin;
-        *begin = 0;
-        *dest = cur_val;
-        *dest <<= offset;
-        uint8_t masked = (cur_val & hi_mask) >> ((sizeof(*buffer_) * 8) - offset);
-        if(masked) {
-            *(dest - 1) |= masked;
+    uint32_t word_shift = value / word_bits_;
+    uint32_t bit_shift = value % word_bits_;
+    uint32_t top = used_words + word_shift;
+    if(top >= word_count_()) {
+        top = word_count_() - 1;
+    }
+    for(uint32_t i = top + 1; i > word_shift; --i) {
+        uint32_t dest = i - 1;
+        uint32_t src = dest - word_shift;
+        uint64_t word = src < used_words ? buffer_[src] << bit_shift : 0;
+        if(bit_shift && src > 0 && src - 1 < used_words) {
+            word |= buffer_[src - 1] >> (word_bits_ - bit_shift);
         }
-        ++begin;
+        buffer_[dest] = word;
+    }
+    for(uint32_t i = 0; i < word_shift; ++i) {
+        buffer_[i] = 0;
     }
     return *this;
 }
@@ -167,75 +220,47 @@ BitVector& BitVector::operator>>=(uint32_t value) {
     if(!buffer_ || !value) {
         return *this;
     }
-    uint8_t* begin = buffer_ + size_ - 1;
-    uint8_t* end = buffer_ - 1;
-    uint8_t offset = value % 8;
-    uint8_t lo_mask = ((1 << offset) - 1);
-    uint8_t bytes_dif = value / 8;
-    while(begin != end) {
-        uint8_t masked = (*begin & lo_mask) << (sizeof(*buffer_) * 8 - offset);
-        uint8_t* dest = begin + bytes_dif;
-        *begin >>= offset;
-        if(distance_(buffer_, dest) < size_) {
-            uint8_t cur_value = *begin;
-            *begin = 0;
-            *dest = cur_value;
-            if(distance_(buffer_,dest + 1) < size_) {
-                *(dest + 1) |= masked;
-            }
+    uint32_t words = word_count_();
+    uint32_t word_shift = value / word_bits_;
+    uint32_t bit_shift = value % word_bits_;
+    for(uint32_t i = 0; i < words; ++i) {
+        uint32_t src = i + word_shift;
+        uint64_t word = src < words ? buffer_[src] >> bit_shift : 0;
+        if(bit_shift && src + 1 < words) {
+            word |= buffer_[src + 1] << (word_bits_ - bit_shift);
         }
-        --begin;
+        buffer_[i] = word;
     }
     return *this;
 }
 
 BitVector& BitVector::operator^=(const BitVector& other) {
-    uint32_t bigget_size = size_ > other.size_ ? size_ : other.size_;
-    int32_t diff = bigget_size - size_;
-    if(diff > 0) {
-        uint8_t* new_buffer = new uint8_t[size_ + diff];
-        for(uint32_t  i = 0; i < diff; ++i) {
-            new_buffer[i] = 0;
-        }
-        for(uint32_t i = 0; i < size_; ++i) {
-            new_buffer[i + diff] = buffer_[i];
-        }
-        delete[] buffer_;
-        buffer_ = new_buffer;
-        size_ += diff;
-    }
-    uint32_t size_other = other.size_;
-    uint8_t* cur = buffer_ + size_ - 1, *cur_other = other.buffer_ + other.size_ - 1;
-    while(size_other) {
-        *cur ^= *cur_other;
-        --cur;
-        --cur_other;
-        --size_other;
+    grow_(other.size_);
+    uint32_t other_words = other.word_count_();
+    for(uint32_t i = 0; i < other_words; ++i) {
+        buffer_[i] ^= other.buffer_[i];
     }
     return *this;
 } 
 
 bool BitVector::operator==(const BitVector& other) {
-    uint8_t* cur = buffer_ + size_ - 1, *cur_other = other.buffer_ + other.size_ - 1;
-    uint8_t* end_cur = buffer_ - 1, *end_other = other.buffer_ - 1;
-    while(cur != end_cur && cur_other != end_other) {
-        if(*cur != *cur_other) {
+    uint32_t words = word_count_();
+    uint32_t other_words = other.word_count_();
+    uint32_t common = words < other_words ? words : other_words;
+    for(uint32_t i = 0; i < common; ++i) {
+        if(buffer_[i] != other.buffer_[i]) {
             return false;
         }
-        --cur;
-        --cur_other;
     }
-    while(cur != end_cur) {
-        if(*cur) {
+    for(uint32_t i = common; i < words; ++i) {
+        if(buffer_[i]) {
             return false;
         }
-        --cur;
     }
-    while(cur_other != end_other) {
-        if(*cur_other) {
+    for(uint32_t i = common; i < other_words; ++i) {
+        if(other.buffer_[i]) {
             return false;
         }
-        --cur_other;
     }
     return true;
 }
@@ -246,62 +271,39 @@ bool BitVector::operator!=(const BitVector& other) {
 
 BitVector::bit_access& BitVector::bit_access::operator=(bool value) {
     BitVector* casted = const_cast<BitVector*>(access_vector);
-    uint32_t byte_offset = position / 8;
-    uint8_t bit_offset = position % 8;
-    uint8_t* dest = &casted->buffer_[access_vector->size_ - 1 - byte_offset];
+    uint64_t* dest = &casted->buffer_[position / word_bits_];
+    uint64_t mask = static_cast<uint64_t>(1) << (position % word_bits_);
     //Thank you stackoverflow for the following piece of code :)
-    *dest ^= (-value ^ *dest) & (1 << bit_offset);
+    *dest ^= (-static_cast<uint64_t>(value) ^ *dest) & mask;
     return *this;
 }
 
 BitVector::bit_access::operator bool() const {
-    uint32_t byte_offset = position / 8;
-    uint8_t bit_offset = position % 8;
-    return access_vector->buffer_[access_vector->size_ - 1 - byte_offset] & (1 << bit_offset);
+    return position < access_vector->size() && access_vector->test(position);
 }
 
 BitVector::bit_access BitVector::operator[](uint32_t position) {
-    uint32_t byte_offset = position / 8 + 1;
-    int32_t diff = byte_offset - size_;
-    if(diff > 0) {
-        uint8_t* new_buffer = new uint8_t[size_ + diff];
-        for(uint32_t  i = 0; i < diff; ++i) {
-            new_buffer[i] = 0;
-        }
-        for(uint32_t i = 0; i < size_; ++i) {
-            new_buffer[i + diff] = buffer_[i];
-        }
-        delete[] buffer_;
-        buffer_ = new_buffer;
-        size_ += diff;
-    }
+    grow_(position / 8 + 1);
     BitVector::bit_access ret(this, position);
     return ret;
 }
 
 const BitVector::bit_access BitVector::operator[](uint32_t position) const {
-    uint32_t byte_offset = position / 8 + 1;
-    int32_t diff = byte_offset - size_;
-    BitVector* casted = const_cast<BitVector*>(this);
-    if(diff > 0) {
-        uint8_t* new_buffer = new uint8_t[size_ + diff];
-        for(uint32_t  i = 0; i < diff; ++i) {
-            new_buffer[i] = 0;
-        }
-        for(uint32_t i = 0; i < size_; ++i) {
-            new_buffer[i + diff] = buffer_[i];
-        }
-        delete[] buffer_;
-        casted->buffer_ = new_buffer;
-        casted->size_ += diff;
-    }
     BitVector::bit_access ret(this, position);
     return ret;
 }
 
 void BitVector::swap(BitVector& other) {
-    swap_(size_, other.size_);
-    swap_(buffer_, other.buffer_);
+    if(buffer_ != inline_ && other.buffer_ != other.inline_) {
+        swap_(size_, other.size_);
+        swap_(capacity_, other.capacity_);
+        swap_(arena_, other.arena_);
+        swap_(buffer_, other.buffer_);
+        return;
+    }
+    BitVector tmp(std::move(other));
+    other = std::move(*this);
+    *this = std::move(tmp);
 }
 
 uint32_t BitVector::size() const {
@@ -309,8 +311,23 @@ uint32_t BitVector::size() const {
     return size_ * 8;
 }
 
+uint32_t BitVector::weight() const {
+    uint32_t words = word_count_();
+    uint32_t ret = 0;
+    for(uint32_t i = 0; i < words; ++i) {
+        ret += __builtin_popcountll(buffer_[i]);
+    }
+    return ret;
+}
+
+BitVector BitVector::detached() const {
+    ScratchArena::Suspend heap;
+    return BitVector(*this);
+}
+
 BitVector::operator bool() const {
-    for(uint32_t i = 0; i < size_; ++i) {
+    uint32_t words = word_count_();
+    for(uint32_t i = 0; i < words; ++i) {
         if(buffer_[i]) {
             return true;
         }
@@ -319,16 +336,30 @@ BitVector::operator bool() const {
 }
 
 void multiply(BitVector& to_be_multiplied, const BitVector& rhs) {
-    BitVector tmp;
-    BitVector other(rhs);
-    while(other) {
-        if(other[0]) {
-            tmp ^= to_be_multiplied;
+    uint8_t left_zero = 0, right_zero = 0;
+    uint32_t left_msb = to_be_multiplied.msb(&left_zero);
+    uint32_t right_msb = rhs.msb(&right_zero);
+    if(left_zero || right_zero) {
+        BitVector zero;
+        to_be_multiplied = std::move(zero);
+        return;
+    }
+    uint32_t left_words = left_msb / word_bits_ + 1;
+    uint32_t right_words = right_msb / word_bits_ + 1;
+    uint32_t product_bytes = (left_msb + right_msb) / 8 + 1;
+    BitVector tmp(Size(product_bytes > to_be_multiplied.size_ ? product_bytes : to_be_multiplied.size_));
+    if(tmp.word_count_() >= left_words + right_words) {
+        clmul_words(to_be_multiplied.buffer_, left_words, rhs.buffer_, right_words, tmp.buffer_);
+    }
+    else {
+        //The product's top word is always zero here, but clmul_words still writes it.
+        std::vector<uint64_t> product(left_words + right_words);
+        clmul_words(to_be_multiplied.buffer_, left_words, rhs.buffer_, right_words, product.data());
+        for(uint32_t i = 0; i < tmp.word_count_(); ++i) {
+            tmp.buffer_[i] = product[i];
         }
-        other >>= 1;
-        to_be_multiplied <<= 1;
     }
-    to_be_multiplied.swap(tmp);
+    to_be_multiplied = std::move(tmp);
 }
 
 BitVector multiply(const BitVector& left, const BitVector& right) {
@@ -337,17 +368,140 @@ BitVector multiply(const BitVector& left, const BitVector& right) {
     return tmp;
 }
 
+//dst ^= src << shift. dst must be big enough to hold every set bit of the shifted value.
+static void xor_shifted_(uint64_t* dst, const uint64_t* src, uint32_t src_words, uint32_t shift) {
+    uint32_t word_shift = shift / word_bits_;
+    uint32_t bit_shift = shift % word_bits_;
+    if(!bit_shift) {
+        for(uint32_t i = 0; i < src_words; ++i) {
+            dst[i + word_shift] ^= src[i];
+        }
+        return;
+    }
+    uint64_t carry = 0;
+    for(uint32_t i = 0; i < src_words; ++i) {
+        dst[i + word_shift] ^= (src[i] << bit_shift) | carry;
+        carry = src[i] >> (word_bits_ - bit_shift);
+    }
+    if(carry) {
+        dst[src_words + word_shift] ^= carry;
+    }
+}
+
 division_result long_division(const BitVector& left, const BitVector& right) {
     division_result ret;
     ret.r = left;
-    BitVector tmp;
-    while(ret.r) {
-        int32_t degree_dif = ret.r.msb(nullptr) - right.msb(nullptr);
-        if(degree_dif < 0) break;
-        tmp = 1;
-        tmp <<= degree_dif;
-        ret.q ^= tmp;
-        ret.r ^= multiply(right, tmp);
+    uint8_t divisor_zero = 0, dividend_zero = 0;
+    uint32_t divisor_degree = right.msb(&divisor_zero);
+    uint32_t dividend_degree = ret.r.msb(&dividend_zero);
+    if(divisor_zero || dividend_zero || dividend_degree < divisor_degree) {
+        return ret;
+    }
+    uint32_t divisor_words = divisor_degree / word_bits_ + 1;
+    BitVector quotient(Size((dividend_degree - divisor_degree) / 8 + 1));
+    ret.q = std::move(quotient);
+    uint64_t* remainder = ret.r.buffer_;
+    for(uint32_t bit = dividend_degree + 1; bit-- > divisor_degree; ) {
+        if((remainder[bit / word_bits_] >> (bit % word_bits_)) & 1) {
+            uint32_t offset = bit - divisor_degree;
+            xor_shifted_(remainder, right.buffer_, divisor_words, offset);
+            ret.q.buffer_[offset / word_bits_] |= static_cast<uint64_t>(1) << (offset % word_bits_);
+        }
+    }
+    return ret;
+}
+
+RemainderTable::RemainderTable(): modulus_(1), degree_(0), words_(0) {
+}
+
+RemainderTable::RemainderTable(const BitVector& modulus): modulus_(modulus), degree_(modulus.msb()), words_((degree_ + word_bits_ - 1) / word_bits_) {
+    if(degree_ < 8) {
+        return;
+    }
+    //powers[j] = x^(r + j) mod g, j < 8.
+    std::vector<uint64_t> powers(8 * words_, 0);
+    const uint32_t top_word = (degree_ - 1) / word_bits_;
+    const uint32_t top_bit = (degree_ - 1) % word_bits_;
+    for(uint32_t i = 0; i < words_; ++i) {
+        powers[i] = modulus_.buffer_[i];
+    }
+    if(degree_ % word_bits_) {
+        //Drop x^r, it isn't part of the r bit state.
+        powers[degree_ / word_bits_] &= ~(static_cast<uint64_t>(1) << (degree_ % word_bits_));
+    }
+    for(uint32_t j = 1; j < 8; ++j) {
+        const uint64_t* previous = &powers[(j - 1) * words_];
+        uint64_t* current = &powers[j * words_];
+        bool overflow = (previous[top_word] >> top_bit) & 1;
+        uint64_t carry = 0;
+        for(uint32_t i = 0; i < words_; ++i) {
+            current[i] = (previous[i] << 1) | carry;
+            carry = previous[i] >> (word_bits_ - 1);
+        }
+        current[top_word] &= top_bit == word_bits_ - 1 ? ~static_cast<uint64_t>(0) : (static_cast<uint64_t>(1) << (top_bit + 1)) - 1;
+        if(overflow) {
+            for(uint32_t i = 0; i < words_; ++i) {
+                current[i] ^= powers[i];
+            }
+        }
+    }
+    table_.assign(256 * words_, 0);
+    for(uint32_t byte = 1; byte < 256; ++byte) {
+        uint64_t* entry = &table_[byte * words_];
+        for(uint32_t j = 0; j < 8; ++j) {
+            if(byte & (1 << j)) {
+                for(uint32_t i = 0; i < words_; ++i) {
+                    entry[i] ^= powers[j * words_ + i];
+                }
+            }
+        }
+    }
+}
+
+BitVector RemainderTable::shifted_remainder(const BitVector& value) const {
+    BitVector ret(Size(degree_ ? (degree_ + 7) / 8 : 1));
+    uint8_t zero = 0;
+    uint32_t value_degree = value.msb(&zero);
+    if(zero || !degree_) {
+        return ret;
+    }
+    if(degree_ < 8) {
+        //State fits in a byte: plain bit serial LFSR.
+        uint64_t state = 0;
+        const uint64_t feedback = modulus_.buffer_[0] & ((static_cast<uint64_t>(1) << degree_) - 1);
+        for(uint32_t bit = value_degree + 1; bit-- > 0; ) {
+            uint64_t in = ((value.buffer_[bit / word_bits_] >> (bit % word_bits_)) & 1) ^ (state >> (degree_ - 1));
+            state = (state << 1) & ((static_cast<uint64_t>(1) << degree_) - 1);
+            if(in) {
+                state ^= feedback;
+            }
+        }
+        ret.buffer_[0] = state;
+        return ret;
+    }
+    uint64_t* state = ret.buffer_;
+    const uint32_t top_word = (degree_ - 1) / word_bits_;
+    const uint32_t top_bits = (degree_ - 1) % word_bits_ + 1;
+    const uint64_t top_mask = top_bits == word_bits_ ? ~static_cast<uint64_t>(0) : (static_cast<uint64_t>(1) << top_bits) - 1;
+    const uint32_t index_shift = degree_ - 8;
+    for(uint32_t byte = value_degree / 8 + 1; byte-- > 0; ) {
+        //Top 8 bits of the state, which may straddle two words.
+        uint32_t index_word = index_shift / word_bits_;
+        uint32_t index_bit = index_shift % word_bits_;
+        uint64_t index = state[index_word] >> index_bit;
+        if(index_bit > word_bits_ - 8 && index_word + 1 < words_) {
+            index |= state[index_word + 1] << (word_bits_ - index_bit);
+        }
+        index = (index ^ value.byte_(byte)) & 0xFF;
+        for(uint32_t i = words_; i-- > 1; ) {
+            state[i] = (state[i] << 8) | (state[i - 1] >> (word_bits_ - 8));
+        }
+        state[0] <<= 8;
+        state[top_word] &= top_mask;
+        const uint64_t* entry = &table_[index * words_];
+        for(uint32_t i = 0; i < words_; ++i) {
+            state[i] ^= entry[i];
+        }
     }
     return ret;
 }
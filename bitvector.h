@@ -19,8 +19,12 @@
 #ifndef BITVECTOR_H
 #define BITVECTOR_H
 
+#include <cassert>
 #include <cstdint>
+#include <cstddef>
 #include <iostream>
+#include <iterator>
+#include <vector>
     
 template<typename Iterator>
 uint32_t distance_(Iterator begin, Iterator end) {
@@ -33,26 +37,122 @@ struct Size {
 };
 
 /**
- * @todo write docs
+ * Polynomial over GF(2), bit i being the coefficient of x^i.
+ * Bits are stored in 64 bit words, least significant word first. size_ is the logical size in bytes,
+ * which is what begin()/end() export (most significant byte first); bits above it are always zero.
+ * Up to inline_words_ words live inside the object, so short polynomials never allocate.
+ * Longer buffers come from the thread's ScratchArena while a ScratchArena::Scope is active, from new[] otherwise.
  */
 class BitVector {        
 public:
     
-    typedef uint8_t* iterator;
+    class byte_iterator {
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef uint8_t value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const uint8_t* pointer;
+        typedef uint8_t reference;
+        
+        byte_iterator(): vector_(nullptr), index_(0) {}
+        
+        byte_iterator(const BitVector* vector, uint32_t index): vector_(vector), index_(index) {}
+        
+        uint8_t operator*() const {
+            return vector_->byte_(vector_->size_ - 1 - index_);
+        }
+        
+        uint8_t operator[](difference_type offset) const {
+            return *(*this + offset);
+        }
+        
+        byte_iterator& operator++() {
+            ++index_;
+            return *this;
+        }
+        
+        byte_iterator operator++(int) {
+            byte_iterator tmp(*this);
+            ++index_;
+            return tmp;
+        }
+        
+        byte_iterator& operator--() {
+            --index_;
+            return *this;
+        }
+        
+        byte_iterator operator--(int) {
+            byte_iterator tmp(*this);
+            --index_;
+            return tmp;
+        }
+        
+        byte_iterator& operator+=(difference_type offset) {
+            index_ += offset;
+            return *this;
+        }
+        
+        byte_iterator& operator-=(difference_type offset) {
+            index_ -= offset;
+            return *this;
+        }
+        
+        byte_iterator operator+(difference_type offset) const {
+            byte_iterator tmp(*this);
+            tmp += offset;
+            return tmp;
+        }
+        
+        byte_iterator operator-(difference_type offset) const {
+            byte_iterator tmp(*this);
+            tmp -= offset;
+            return tmp;
+        }
+        
+        difference_type operator-(const byte_iterator& other) const {
+            return static_cast<difference_type>(index_) - static_cast<difference_type>(other.index_);
+        }
+        
+        bool operator==(const byte_iterator& other) const {
+            return index_ == other.index_;
+        }
+        
+        bool operator!=(const byte_iterator& other) const {
+            return index_ != other.index_;
+        }
+        
+        bool operator<(const byte_iterator& other) const {
+            return index_ < other.index_;
+        }
+        
+        bool operator>(const byte_iterator& other) const {
+            return index_ > other.index_;
+        }
+        
+        bool operator<=(const byte_iterator& other) const {
+            return index_ <= other.index_;
+        }
+        
+        bool operator>=(const byte_iterator& other) const {
+            return index_ >= other.index_;
+        }
+        
+    private:
+        const BitVector* vector_;
+        uint32_t index_;
+    };
+    
+    typedef byte_iterator iterator;
     
-    typedef const uint8_t* const_iterator;
+    typedef byte_iterator const_iterator;
     
     template<typename T>
-    BitVector(T value): size_(sizeof(value)), buffer_(new uint8_t[size_]) {
-        uint8_t* cur = buffer_ + size_ - 1;
-        for(uint8_t i = 0; i < size_; ++i) {
-            *cur = value & ((1 << sizeof(buffer_)) - 1);
-            --cur;
-            value >>= 8;
-        }
+    BitVector(T value): size_(sizeof(value)), capacity_(inline_words_), arena_(false), buffer_(inline_) {
+        *buffer_ = to_word_(value);
     }
     
-    BitVector(): size_(1), buffer_(new uint8_t[size_]) {
+    BitVector(): size_(1), capacity_(inline_words_), arena_(false), buffer_(inline_) {
         *buffer_ = 0;
     }
     
@@ -63,29 +163,24 @@ public:
     
     BitVector(const BitVector&);
     
+    BitVector(BitVector&&) noexcept;
+    
     ~BitVector();
     
     BitVector& operator=(const BitVector&);
     
+    BitVector& operator=(BitVector&&) noexcept;
+    
     template<typename T>
     BitVector& operator=(T value) {
-        int32_t diff = sizeof(value) - size_;
-        if(diff > 0) {
-            size_ += diff;
-            uint8_t* new_buffer = new uint8_t[size_];
-            delete[] buffer_;
-            buffer_ = new_buffer;
-        }
-        uint8_t* cur = buffer_ + size_ - 1;
-        uint8_t* end = buffer_ - 1;
-        for(uint8_t i = 0; i < sizeof(value); ++i) {
-            *cur = value & ((1 << sizeof(buffer_)) - 1);
-            --cur;
-            value >>= 8;
-        }
-        while(cur != end) {
-            *cur = 0;
-            --cur;
+        //A single word always fits, inline or not.
+        if(sizeof(value) > size_) {
+            size_ = sizeof(value);
+        }
+        uint32_t words = word_count_();
+        *buffer_ = to_word_(value);
+        for(uint32_t i = 1; i < words; ++i) {
+            buffer_[i] = 0;
         }
         return *this;
     }
@@ -138,6 +233,12 @@ public:
     
     friend class bit_access;
     
+    friend void multiply(BitVector&, const BitVector&);
+    
+    friend struct division_result long_division(const BitVector&, const BitVector&);
+    
+    friend class RemainderTable;
+    
     struct bit_access {
         bit_access(const BitVector* const vector, uint32_t pos): access_vector(vector), position(pos) {}
         
@@ -150,10 +251,44 @@ public:
         uint32_t position;
     };
     
+    //Grows the vector to hold position.
     bit_access operator[](uint32_t);
     
+    //Positions past the end read as zero, the vector is left untouched.
     const bit_access operator[](uint32_t) const;
     
+    //Direct bit access for positions below size(), only checked by assert in debug builds.
+    bool test(uint32_t position) const {
+        assert(position < size());
+        return buffer_[word_index_(position)] & bit_mask_(position);
+    }
+    
+    void set(uint32_t position) {
+        assert(position < size());
+        buffer_[word_index_(position)] |= bit_mask_(position);
+    }
+    
+    void clear(uint32_t position) {
+        assert(position < size());
+        buffer_[word_index_(position)] &= ~bit_mask_(position);
+    }
+    
+    void flip(uint32_t position) {
+        assert(position < size());
+        buffer_[word_index_(position)] ^= bit_mask_(position);
+    }
+    
+    //Calls function(position) for every set bit, lowest position first.
+    template<typename Function>
+    void for_each_set_bit(Function function) const {
+        uint32_t words = word_count_();
+        for(uint32_t i = 0; i < words; ++i) {
+            for(uint64_t word = buffer_[i]; word; word &= word - 1) {
+                function(static_cast<uint32_t>(i * sizeof(uint64_t) * 8) + __builtin_ctzll(word));
+            }
+        }
+    }
+    
     void swap(BitVector&);
     
     template<typename Iterator>
@@ -163,45 +298,99 @@ public:
     
     uint32_t size() const;
     
+    //Number of set bits.
+    uint32_t weight() const;
+    
+    //Copy backed by the heap (or inline storage) even inside a ScratchArena::Scope, for values that outlive the scope.
+    BitVector detached() const;
+    
     iterator begin() {
-        return buffer_;
+        return byte_iterator(this, 0);
     }
     
     iterator end() {
-        return buffer_ + size_;
+        return byte_iterator(this, size_);
     }
     
     const_iterator begin() const {
-        return buffer_;
+        return byte_iterator(this, 0);
     }
     
     const_iterator end() const {
-        return buffer_ + size_;
+        return byte_iterator(this, size_);
     }
     
 private:
+    static constexpr uint32_t inline_words_ = 4;
+    
+    template<typename T>
+    static uint64_t to_word_(T value) {
+        uint64_t word = static_cast<uint64_t>(value);
+        if(sizeof(value) < sizeof(word)) {
+            word &= (static_cast<uint64_t>(1) << (sizeof(value) * 8)) - 1;
+        }
+        return word;
+    }
+    
+    static uint32_t words_for_(uint32_t bytes) {
+        return (bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    }
+    
+    static uint32_t word_index_(uint32_t position) {
+        return position / (sizeof(uint64_t) * 8);
+    }
+    
+    static uint64_t bit_mask_(uint32_t position) {
+        return static_cast<uint64_t>(1) << (position % (sizeof(uint64_t) * 8));
+    }
+    
+    uint32_t word_count_() const {
+        return words_for_(size_);
+    }
+    
+    //byte_(0) is the least significant byte.
+    uint8_t byte_(uint32_t index) const {
+        return buffer_[index / sizeof(uint64_t)] >> ((index % sizeof(uint64_t)) * 8);
+    }
+    
+    void grow_(uint32_t bytes);
+    
+    //Makes room for words words without keeping the contents.
+    void allocate_(uint32_t words);
+    
+    void release_();
+    
+    //Takes other's contents, leaving it empty.
+    void take_(BitVector& other);
+    
     uint32_t size_;
     
-    uint8_t* buffer_;
+    uint32_t capacity_;
+    
+    //buffer_ belongs to a ScratchArena and must not be deleted.
+    bool arena_;
+    
+    uint64_t* buffer_;
+    
+    uint64_t inline_[inline_words_];
 };
 
 template<typename Iterator>
-BitVector::BitVector(Iterator begin, Iterator end): size_(0), buffer_(nullptr) {
+BitVector::BitVector(Iterator begin, Iterator end): size_(0), capacity_(inline_words_), arena_(false), buffer_(inline_) {
     reset(begin, end);
 }
 
 template<typename Iterator>
 void BitVector::reset(Iterator begin, Iterator end) {
-    delete[] buffer_;
     size_ = distance_(begin, end);
-    if(size_) {
-        buffer_ = new uint8_t[size_];
-    }
-    else {
-        buffer_ = nullptr;
+    uint32_t words = word_count_();
+    allocate_(words);
+    for(uint32_t i = 0; i < words; ++i) {
+        buffer_[i] = 0;
     }
-    for(uint32_t i = 0; i < size_; ++i) {
-        buffer_[i] = *begin;
+    for(uint32_t i = size_; i > 0; --i) {
+        uint32_t byte_index = i - 1;
+        buffer_[byte_index / sizeof(uint64_t)] |= static_cast<uint64_t>(static_cast<uint8_t>(*begin)) << ((byte_index % sizeof(uint64_t)) * 8);
         ++begin;
     }
 }
@@ -215,7 +404,32 @@ struct division_result {
     BitVector r;
 };
 
+//Reduces in place: the divisor is XORed into the remainder at the quotient bit offsets, no temporaries are built.
 division_result long_division(const BitVector&, const BitVector&);
 
+/**
+ * Byte-at-a-time (Sarwate, as in table driven CRCs) remainder modulo a fixed polynomial g of degree r.
+ * table_ holds (i * x^r) mod g for every byte i, so the message is streamed through an r bit LFSR state one byte per step.
+ */
+class RemainderTable {
+public:
+    RemainderTable();
+    
+    explicit RemainderTable(const BitVector& modulus);
+    
+    //(value * x^r) mod g, i.e. the parity of a systematic cyclic code.
+    BitVector shifted_remainder(const BitVector& value) const;
+    
+    uint32_t degree() const {
+        return degree_;
+    }
+    
+private:
+    BitVector modulus_;
+    uint32_t degree_;
+    uint32_t words_;
+    std::vector<uint64_t> table_;
+};
+
 
 #endif // BITVECTOR_H
@@ -0,0 +1,139 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "blockcode.h"
+#include "scratcharena.h"
+#include <condition_variable>
+#include <mutex>
+
+BlockCode::BlockCode(const BCH& code, uint32_t block_bytes): code_(code), block_bytes_(block_bytes) {
+    codeword_bytes_ = (code_.code_length() + 7) / 8;
+    message_bytes_ = (code_.message_length() + 7) / 8;
+    if(!block_bytes_ || block_bytes_ > code_.code_length() / 8) {
+        block_bytes_ = code_.code_length() / 8;
+    }
+}
+
+const BCH& BlockCode::code() const {
+    return code_;
+}
+
+uint32_t BlockCode::block_bytes() const {
+    return block_bytes_;
+}
+
+uint32_t BlockCode::codeword_bytes() const {
+    return codeword_bytes_;
+}
+
+uint32_t BlockCode::message_bytes() const {
+    return message_bytes_;
+}
+
+uint32_t BlockCode::blocks(std::size_t input_bytes) const {
+    return (input_bytes + block_bytes_ - 1) / block_bytes_;
+}
+
+std::size_t BlockCode::sketch_bytes(std::size_t input_bytes) const {
+    return std::size_t(blocks(input_bytes)) * codeword_bytes_;
+}
+
+void BlockCode::sketch(const uint8_t* input, std::size_t input_bytes, uint32_t first, uint32_t count, const uint8_t* messages, uint8_t* out) const {
+    code_.encode_batch(messages, count, out);
+    add_input_(input, input_bytes, first, count, out);
+}
+
+void BlockCode::sketches(const uint8_t* input, std::size_t input_bytes, std::size_t count, const uint8_t* messages, uint8_t* out) const {
+    const uint32_t per_sketch = blocks(input_bytes);
+    code_.encode_batch(messages, count * per_sketch, out);
+    for(std::size_t i = 0; i < count; ++i) {
+        add_input_(input, input_bytes, 0, per_sketch, out + i * sketch_bytes(input_bytes));
+    }
+}
+
+void BlockCode::recover(const uint8_t* sketch, const uint8_t* noisy, std::size_t input_bytes, uint32_t first, uint32_t count,
+                        uint8_t* out, uint8_t* errors) const {
+    ScratchArena::Scope scratch;
+    //sketch ^ noisy is the codeword of each block plus the reading's errors.
+    std::size_t total = std::size_t(count) * codeword_bytes_;
+    ScratchBuffer<uint8_t> received(total), corrected(total), failed(count);
+    for(std::size_t i = 0; i < total; ++i) {
+        received[i] = sketch[i];
+    }
+    for(uint32_t i = 0; i < count; ++i) {
+        uint32_t size = block_size_(input_bytes, first + i);
+        const uint8_t* block = noisy + std::size_t(first + i) * block_bytes_;
+        uint8_t* codeword = received.data() + std::size_t(i) * codeword_bytes_ + codeword_bytes_ - size;
+        for(uint32_t j = 0; j < size; ++j) {
+            codeword[j] ^= block[j];
+        }
+    }
+    code_.decode_batch(received.data(), count, corrected.data(), failed.data());
+    for(uint32_t i = 0; i < count; ++i) {
+        uint32_t size = block_size_(input_bytes, first + i);
+        std::size_t offset = std::size_t(i) * codeword_bytes_ + codeword_bytes_ - size;
+        uint8_t* block = out + std::size_t(i) * block_bytes_;
+        for(uint32_t j = 0; j < size; ++j) {
+            block[j] = failed[i] ? noisy[std::size_t(first + i) * block_bytes_ + j] : corrected[offset + j] ^ sketch[offset + j];
+        }
+        if(errors) {
+            errors[i] = failed[i];
+        }
+    }
+}
+
+void BlockCode::recover(const uint8_t* sketch, const uint8_t* noisy, std::size_t input_bytes, uint8_t* out, uint8_t* errors,
+                        ThreadPool& pool) const {
+    const uint32_t count = blocks(input_bytes);
+    const uint32_t groups = (count + group_blocks - 1) / group_blocks;
+    //The pool may be running other work, so groups are counted here rather than with pool.wait().
+    std::mutex mutex;
+    std::condition_variable done;
+    uint32_t finished = 0;
+    for(uint32_t group = 0; group < groups; ++group) {
+        pool.submit([&, group](uint32_t) {
+            uint32_t first = group * group_blocks;
+            uint32_t size = count - first < group_blocks ? count - first : group_blocks;
+            recover(sketch + std::size_t(first) * codeword_bytes_, noisy, input_bytes, first, size,
+                    out + std::size_t(first) * block_bytes_, errors ? errors + first : nullptr);
+            std::lock_guard<std::mutex> lock(mutex);
+            if(++finished == groups) {
+                done.notify_one();
+            }
+        });
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&]() { return finished == groups; });
+}
+
+void BlockCode::add_input_(const uint8_t* input, std::size_t input_bytes, uint32_t first, uint32_t count, uint8_t* out) const {
+    for(uint32_t i = 0; i < count; ++i) {
+        uint32_t size = block_size_(input_bytes, first + i);
+        const uint8_t* block = input + std::size_t(first + i) * block_bytes_;
+        uint8_t* codeword = out + std::size_t(i) * codeword_bytes_ + codeword_bytes_ - size;
+        for(uint32_t j = 0; j < size; ++j) {
+            codeword[j] ^= block[j];
+        }
+    }
+}
+
+uint32_t BlockCode::block_size_(std::size_t input_bytes, uint32_t index) const {
+    std::size_t start = std::size_t(index) * block_bytes_;
+    return input_bytes - start < block_bytes_ ? input_bytes - start : block_bytes_;
+}
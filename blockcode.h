@@ -0,0 +1,97 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BLOCKCODE_H
+#define BLOCKCODE_H
+
+#include <cstddef>
+#include <cstdint>
+#include "bch.h"
+#include "threadpool.h"
+
+/**
+ * Secure sketches of inputs larger than one codeword. The input is cut into blocks of block_bytes() bytes, the last
+ * one possibly shorter, and every block is protected by its own BCH codeword: sketch block i is codeword i XOR input
+ * block i, the input bytes lining up with the low end of the codeword bytes. Blocks are independent, so any range of
+ * them can be processed separately (e.g. on different threads).
+ * Byte strings are most significant byte first, as BitVector::begin() exports them.
+ */
+class BlockCode {
+public:
+    //Blocks filling one bit sliced group of BCH::encode_batch and BCH::decode_batch, the unit of work to split
+    //a large input at.
+    static const uint32_t group_blocks = 256;
+    
+    //block_bytes = 0 picks the largest block a codeword covers, code.code_length() / 8 bytes, which must be at
+    //least 1 (a field of order 4 or more).
+    explicit BlockCode(const BCH& code, uint32_t block_bytes = 0);
+    
+    const BCH& code() const;
+    
+    uint32_t block_bytes() const;
+    
+    uint32_t codeword_bytes() const;
+    
+    uint32_t message_bytes() const;
+    
+    //Number of blocks covering input_bytes bytes.
+    uint32_t blocks(std::size_t input_bytes) const;
+    
+    std::size_t sketch_bytes(std::size_t input_bytes) const;
+    
+    /**
+     * Writes sketch blocks [first, first + count) to out, count * codeword_bytes() bytes. Block first + i is built from
+     * message i of messages, each message_bytes() long with only the low code().message_length() bits used.
+     */
+    void sketch(const uint8_t* input, std::size_t input_bytes, uint32_t first, uint32_t count, const uint8_t* messages, uint8_t* out) const;
+    
+    /**
+     * Writes count whole sketches to out, one after the other, from count * blocks(input_bytes) messages laid out
+     * as for sketch. The codewords of all of them are encoded in one batch, so small inputs batch across sketches.
+     */
+    void sketches(const uint8_t* input, std::size_t input_bytes, std::size_t count, const uint8_t* messages, uint8_t* out) const;
+    
+    /**
+     * Recovers the input bytes of blocks [first, first + count) from their sketch blocks and a noisy reading of the
+     * input, writing them to out. If a block has too many errors its noisy bytes are copied and, when errors isn't
+     * null, errors[i] is set to 1.
+     */
+    void recover(const uint8_t* sketch, const uint8_t* noisy, std::size_t input_bytes, uint32_t first, uint32_t count,
+                 uint8_t* out, uint8_t* errors = nullptr) const;
+    
+    /**
+     * Recovers a whole input of input_bytes bytes as above, spreading groups of group_blocks blocks over pool.
+     * errors, if not null, has blocks(input_bytes) entries. Must not be called from a task of pool.
+     */
+    void recover(const uint8_t* sketch, const uint8_t* noisy, std::size_t input_bytes, uint8_t* out, uint8_t* errors,
+                 ThreadPool& pool) const;
+    
+private:
+    BCH code_;
+    uint32_t block_bytes_;
+    uint32_t codeword_bytes_;
+    uint32_t message_bytes_;
+    
+    uint32_t block_size_(std::size_t input_bytes, uint32_t index) const;
+    
+    //XORs input blocks [first, first + count) into the count codewords at out.
+    void add_input_(const uint8_t* input, std::size_t input_bytes, uint32_t first, uint32_t count, uint8_t* out) const;
+};
+
+#endif // BLOCKCODE_H
@@ -0,0 +1,217 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "chacha20.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <random>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CHACHA20_X86_
+#endif
+
+typedef void (*blocks_kernel_)(const uint32_t* state, uint8_t* out);
+
+static inline uint32_t rotate_(uint32_t value, uint32_t bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static inline void quarter_round_(uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d) {
+    a += b; d = rotate_(d ^ a, 16);
+    c += d; b = rotate_(b ^ c, 12);
+    a += b; d = rotate_(d ^ a, 8);
+    c += d; b = rotate_(b ^ c, 7);
+}
+
+static void block_(const uint32_t* state, uint8_t* out) {
+    uint32_t x[16];
+    for(uint32_t i = 0; i < 16; ++i) {
+        x[i] = state[i];
+    }
+    for(uint32_t round = 0; round < 10; ++round) {
+        quarter_round_(x[0], x[4], x[8], x[12]);
+        quarter_round_(x[1], x[5], x[9], x[13]);
+        quarter_round_(x[2], x[6], x[10], x[14]);
+        quarter_round_(x[3], x[7], x[11], x[15]);
+        quarter_round_(x[0], x[5], x[10], x[15]);
+        quarter_round_(x[1], x[6], x[11], x[12]);
+        quarter_round_(x[2], x[7], x[8], x[13]);
+        quarter_round_(x[3], x[4], x[9], x[14]);
+    }
+    for(uint32_t i = 0; i < 16; ++i) {
+        uint32_t word = x[i] + state[i];
+        out[4 * i] = word;
+        out[4 * i + 1] = word >> 8;
+        out[4 * i + 2] = word >> 16;
+        out[4 * i + 3] = word >> 24;
+    }
+}
+
+//Words 12 and 13 of the state are a 64-bit block counter.
+static void next_counter_(uint32_t* state) {
+    if(!++state[12]) {
+        ++state[13];
+    }
+}
+
+static void blocks_scalar_(const uint32_t* state, uint8_t* out) {
+    uint32_t counter[16];
+    std::memcpy(counter, state, sizeof(counter));
+    for(uint32_t i = 0; i < 4; ++i, out += 64) {
+        block_(counter, out);
+        next_counter_(counter);
+    }
+}
+
+#ifdef CHACHA20_X86_
+#define CHACHA20_ROTATE_(x, bits) _mm_or_si128(_mm_slli_epi32(x, bits), _mm_srli_epi32(x, 32 - (bits)))
+#define CHACHA20_QUARTER_(a, b, c, d) \
+    a = _mm_add_epi32(a, b); d = CHACHA20_ROTATE_(_mm_xor_si128(d, a), 16); \
+    c = _mm_add_epi32(c, d); b = CHACHA20_ROTATE_(_mm_xor_si128(b, c), 12); \
+    a = _mm_add_epi32(a, b); d = CHACHA20_ROTATE_(_mm_xor_si128(d, a), 8); \
+    c = _mm_add_epi32(c, d); b = CHACHA20_ROTATE_(_mm_xor_si128(b, c), 7)
+
+//Four consecutive blocks at once: lane j of x[i] is word i of block j.
+__attribute__((target("sse2")))
+static void blocks_sse2_(const uint32_t* state, uint8_t* out) {
+    if(state[12] > 0xFFFFFFFCu) {
+        //The counter carries into word 13 inside this batch.
+        blocks_scalar_(state, out);
+        return;
+    }
+    __m128i input[16], x[16];
+    for(uint32_t i = 0; i < 16; ++i) {
+        input[i] = _mm_set1_epi32(state[i]);
+    }
+    input[12] = _mm_add_epi32(input[12], _mm_set_epi32(3, 2, 1, 0));
+    for(uint32_t i = 0; i < 16; ++i) {
+        x[i] = input[i];
+    }
+    for(uint32_t round = 0; round < 10; ++round) {
+        CHACHA20_QUARTER_(x[0], x[4], x[8], x[12]);
+        CHACHA20_QUARTER_(x[1], x[5], x[9], x[13]);
+        CHACHA20_QUARTER_(x[2], x[6], x[10], x[14]);
+        CHACHA20_QUARTER_(x[3], x[7], x[11], x[15]);
+        CHACHA20_QUARTER_(x[0], x[5], x[10], x[15]);
+        CHACHA20_QUARTER_(x[1], x[6], x[11], x[12]);
+        CHACHA20_QUARTER_(x[2], x[7], x[8], x[13]);
+        CHACHA20_QUARTER_(x[3], x[4], x[9], x[14]);
+    }
+    //Transpose each group of four words so that every register holds four words of a single block.
+    for(uint32_t i = 0; i < 16; i += 4) {
+        __m128i a = _mm_add_epi32(x[i], input[i]);
+        __m128i b = _mm_add_epi32(x[i + 1], input[i + 1]);
+        __m128i c = _mm_add_epi32(x[i + 2], input[i + 2]);
+        __m128i d = _mm_add_epi32(x[i + 3], input[i + 3]);
+        __m128i ab_low = _mm_unpacklo_epi32(a, b), ab_high = _mm_unpackhi_epi32(a, b);
+        __m128i cd_low = _mm_unpacklo_epi32(c, d), cd_high = _mm_unpackhi_epi32(c, d);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * i), _mm_unpacklo_epi64(ab_low, cd_low));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 64 + 4 * i), _mm_unpackhi_epi64(ab_low, cd_low));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 128 + 4 * i), _mm_unpacklo_epi64(ab_high, cd_high));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 192 + 4 * i), _mm_unpackhi_epi64(ab_high, cd_high));
+    }
+}
+
+#undef CHACHA20_QUARTER_
+#undef CHACHA20_ROTATE_
+#endif
+
+static bool sse2_supported_() {
+#ifdef CHACHA20_X86_
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#else
+    return false;
+#endif
+}
+
+static blocks_kernel_ kernel_function_(ChaCha20::kernel kernel) {
+#ifdef CHACHA20_X86_
+    if(kernel == ChaCha20::kernel::sse2) {
+        return blocks_sse2_;
+    }
+#endif
+    return blocks_scalar_;
+}
+
+static std::atomic<blocks_kernel_>& selected_blocks_kernel_() {
+    static std::atomic<blocks_kernel_> selected(kernel_function_(sse2_supported_() ? ChaCha20::kernel::sse2 : ChaCha20::kernel::scalar));
+    return selected;
+}
+
+static blocks_kernel_ blocks_kernel() {
+    return selected_blocks_kernel_().load(std::memory_order_relaxed);
+}
+
+bool ChaCha20::set_kernel(kernel selected) {
+    if(selected == kernel::sse2 && !sse2_supported_()) {
+        return false;
+    }
+    selected_blocks_kernel_().store(kernel_function_(selected), std::memory_order_relaxed);
+    return true;
+}
+
+ChaCha20::ChaCha20(const uint32_t* key, uint64_t stream): buffered_(0) {
+    //"expand 32-byte k"
+    state_[0] = 0x61707865;
+    state_[1] = 0x3320646E;
+    state_[2] = 0x79622D32;
+    state_[3] = 0x6B206574;
+    for(uint32_t i = 0; i < key_words; ++i) {
+        state_[4 + i] = key[i];
+    }
+    state_[12] = 0;
+    state_[13] = 0;
+    state_[14] = static_cast<uint32_t>(stream);
+    state_[15] = static_cast<uint32_t>(stream >> 32);
+}
+
+void ChaCha20::fill(uint8_t* out, std::size_t bytes) {
+    const std::size_t batch_bytes = sizeof(buffer_);
+    //Leftovers of the last batch come first, then whole batches go straight to out.
+    std::size_t taken = std::min<std::size_t>(bytes, buffered_);
+    std::memcpy(out, buffer_ + batch_bytes - buffered_, taken);
+    buffered_ -= taken;
+    out += taken;
+    bytes -= taken;
+    for(; bytes >= batch_bytes; out += batch_bytes, bytes -= batch_bytes) {
+        blocks_(out);
+    }
+    if(bytes) {
+        blocks_(buffer_);
+        std::memcpy(out, buffer_, bytes);
+        buffered_ = batch_bytes - bytes;
+    }
+}
+
+void ChaCha20::random_key(uint32_t* key) {
+    std::random_device device;
+    for(uint32_t i = 0; i < key_words; ++i) {
+        key[i] = device();
+    }
+}
+
+void ChaCha20::blocks_(uint8_t* out) {
+    blocks_kernel()(state_, out);
+    for(uint32_t i = 0; i < batch_blocks_; ++i) {
+        next_counter_(state_);
+    }
+}
@@ -0,0 +1,64 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CHACHA20_H
+#define CHACHA20_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * ChaCha20 keystream used as a random byte source. The 256-bit key selects the generator and the 64-bit stream
+ * number picks one of 2^64 independent streams for it, so parallel users can share a key without overlapping.
+ * Blocks are produced four at a time with SSE2 where available.
+ */
+class ChaCha20 {
+public:
+    static const uint32_t key_words = 8;
+    
+    ChaCha20(const uint32_t* key, uint64_t stream);
+    
+    //Fills out with the next bytes of the stream.
+    void fill(uint8_t* out, std::size_t bytes);
+    
+    //Key read from std::random_device.
+    static void random_key(uint32_t* key);
+    
+    enum class kernel {
+        scalar,
+        sse2
+    };
+    
+    //Replaces the block kernel picked at startup, so tests can cover both. Returns false, changing nothing, if
+    //the CPU lacks it. Only meant for testing.
+    static bool set_kernel(kernel selected);
+    
+private:
+    static const uint32_t block_bytes_ = 64;
+    static const uint32_t batch_blocks_ = 4;
+    
+    uint32_t state_[16];
+    uint8_t buffer_[batch_blocks_ * block_bytes_];
+    uint32_t buffered_;
+    
+    //Writes the next batch_blocks_ blocks to out and advances the block counter.
+    void blocks_(uint8_t* out);
+};
+
+#endif // CHACHA20_H
@@ -0,0 +1,225 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "clmul.h"
+#include "scratcharena.h"
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <wmmintrin.h>
+#define CLMUL_X86_
+#endif
+
+typedef void (*base_case_)(const uint64_t*, uint32_t, const uint64_t*, uint32_t, uint64_t*);
+
+//Read once per clmul_words call, so a concurrent set_karatsuba_threshold can't change it halfway through.
+static std::atomic<uint32_t> karatsuba_threshold_(16);
+
+static void clmul64_portable_(uint64_t left, uint64_t right, uint64_t& lo, uint64_t& hi) {
+    //table[i] = left * i for every 4 bit i, as a 128 bit value.
+    uint64_t table_lo[16], table_hi[16];
+    table_lo[0] = table_hi[0] = 0;
+    table_lo[1] = left;
+    table_hi[1] = 0;
+    for(uint32_t i = 2; i < 16; i += 2) {
+        table_lo[i] = table_lo[i / 2] << 1;
+        table_hi[i] = (table_hi[i / 2] << 1) | (table_lo[i / 2] >> 63);
+        table_lo[i + 1] = table_lo[i] ^ left;
+        table_hi[i + 1] = table_hi[i];
+    }
+    uint64_t acc_lo = 0, acc_hi = 0;
+    for(int32_t shift = 60; shift >= 0; shift -= 4) {
+        acc_hi = (acc_hi << 4) | (acc_lo >> 60);
+        acc_lo <<= 4;
+        uint32_t nibble = (right >> shift) & 0xF;
+        acc_lo ^= table_lo[nibble];
+        acc_hi ^= table_hi[nibble];
+    }
+    lo = acc_lo;
+    hi = acc_hi;
+}
+
+static void schoolbook_portable_(const uint64_t* left, uint32_t left_words, const uint64_t* right, uint32_t right_words, uint64_t* out) {
+    for(uint32_t i = 0; i < left_words; ++i) {
+        if(!left[i]) {
+            continue;
+        }
+        for(uint32_t j = 0; j < right_words; ++j) {
+            uint64_t lo, hi;
+            clmul64_portable_(left[i], right[j], lo, hi);
+            out[i + j] ^= lo;
+            out[i + j + 1] ^= hi;
+        }
+    }
+}
+
+#ifdef CLMUL_X86_
+__attribute__((target("pclmul,sse2")))
+static void schoolbook_pclmul_(const uint64_t* left, uint32_t left_words, const uint64_t* right, uint32_t right_words, uint64_t* out) {
+    for(uint32_t i = 0; i < left_words; ++i) {
+        if(!left[i]) {
+            continue;
+        }
+        __m128i a = _mm_cvtsi64_si128(static_cast<long long>(left[i]));
+        for(uint32_t j = 0; j < right_words; ++j) {
+            __m128i b = _mm_cvtsi64_si128(static_cast<long long>(right[j]));
+            __m128i product = _mm_clmulepi64_si128(a, b, 0x00);
+            out[i + j] ^= static_cast<uint64_t>(_mm_cvtsi128_si64(product));
+            out[i + j + 1] ^= static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(product, product)));
+        }
+    }
+}
+#endif
+
+static bool pclmul_supported_() {
+#ifdef CLMUL_X86_
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("pclmul");
+#else
+    return false;
+#endif
+}
+
+static base_case_ kernel_base_case_(clmul_kernel kernel) {
+#ifdef CLMUL_X86_
+    if(kernel == clmul_kernel::pclmul) {
+        return schoolbook_pclmul_;
+    }
+#endif
+    return schoolbook_portable_;
+}
+
+static std::atomic<base_case_>& selected_base_case_() {
+    static std::atomic<base_case_> selected(kernel_base_case_(pclmul_supported_() ? clmul_kernel::pclmul : clmul_kernel::portable));
+    return selected;
+}
+
+static base_case_ base_case() {
+    return selected_base_case_().load(std::memory_order_relaxed);
+}
+
+bool clmul_hardware_support() {
+    return base_case() != schoolbook_portable_;
+}
+
+bool set_clmul_kernel(clmul_kernel kernel) {
+    if(kernel == clmul_kernel::pclmul && !pclmul_supported_()) {
+        return false;
+    }
+    selected_base_case_().store(kernel_base_case_(kernel), std::memory_order_relaxed);
+    return true;
+}
+
+uint32_t karatsuba_threshold() {
+    return karatsuba_threshold_.load(std::memory_order_relaxed);
+}
+
+void set_karatsuba_threshold(uint32_t words) {
+    karatsuba_threshold_.store(words < 2 ? 2 : words, std::memory_order_relaxed);
+}
+
+//Scratch words needed by karatsuba_ for operands of the given size.
+static uint32_t karatsuba_scratch_(uint32_t words, uint32_t threshold) {
+    uint32_t ret = 0;
+    while(words >= threshold) {
+        uint32_t high = words - words / 2;
+        ret += 4 * high;
+        words = high;
+    }
+    return ret;
+}
+
+//out (2 * words words) = left * right, both operands having the same number of words. out starts zeroed.
+static void karatsuba_(const uint64_t* left, const uint64_t* right, uint32_t words, uint64_t* out, uint64_t* scratch,
+                       uint32_t threshold, base_case_ base) {
+    if(words < threshold) {
+        base(left, words, right, words, out);
+        return;
+    }
+    uint32_t low = words / 2;
+    uint32_t high = words - low;
+    uint64_t* left_sum = scratch;
+    uint64_t* right_sum = left_sum + high;
+    uint64_t* middle = right_sum + high;
+    uint64_t* next = middle + 2 * high;
+    for(uint32_t i = 0; i < high; ++i) {
+        left_sum[i] = left[low + i] ^ (i < low ? left[i] : 0);
+        right_sum[i] = right[low + i] ^ (i < low ? right[i] : 0);
+    }
+    for(uint32_t i = 0; i < 2 * high; ++i) {
+        middle[i] = 0;
+    }
+    karatsuba_(left_sum, right_sum, high, middle, next, threshold, base);
+    //Low and high products go straight to their final place; they don't overlap.
+    karatsuba_(left, right, low, out, next, threshold, base);
+    karatsuba_(left + low, right + low, high, out + 2 * low, next, threshold, base);
+    for(uint32_t i = 0; i < 2 * low; ++i) {
+        middle[i] ^= out[i];
+    }
+    for(uint32_t i = 0; i < 2 * high; ++i) {
+        middle[i] ^= out[2 * low + i];
+    }
+    for(uint32_t i = 0; i < 2 * high; ++i) {
+        out[low + i] ^= middle[i];
+    }
+}
+
+static void clmul_words_(const uint64_t* left, uint32_t left_words, const uint64_t* right, uint32_t right_words, uint64_t* out,
+                         uint32_t threshold, base_case_ base) {
+    for(uint32_t i = 0; i < left_words + right_words; ++i) {
+        out[i] = 0;
+    }
+    if(!left_words || !right_words) {
+        return;
+    }
+    if(left_words < right_words) {
+        const uint64_t* tmp = left;
+        left = right;
+        right = tmp;
+        uint32_t tmp_words = left_words;
+        left_words = right_words;
+        right_words = tmp_words;
+    }
+    if(right_words < threshold) {
+        base(left, left_words, right, right_words, out);
+        return;
+    }
+    //Cut the longer operand in pieces as long as the shorter one, so every product is balanced.
+    const uint32_t scratch_words = karatsuba_scratch_(right_words, threshold);
+    ScratchBuffer<uint64_t> scratch(scratch_words + 2 * right_words);
+    uint64_t* product = scratch.data() + scratch_words;
+    for(uint32_t offset = 0; offset < left_words; offset += right_words) {
+        uint32_t piece = left_words - offset < right_words ? left_words - offset : right_words;
+        for(uint32_t i = 0; i < 2 * right_words; ++i) {
+            product[i] = 0;
+        }
+        if(piece == right_words) {
+            karatsuba_(left + offset, right, right_words, product, scratch.data(), threshold, base);
+        }
+        else {
+            clmul_words_(right, right_words, left + offset, piece, product, threshold, base);
+        }
+        for(uint32_t i = 0; i < piece + right_words; ++i) {
+            out[offset + i] ^= product[i];
+        }
+    }
+}
+
+void clmul_words(const uint64_t* left, uint32_t left_words, const uint64_t* right, uint32_t right_words, uint64_t* out) {
+    clmul_words_(left, left_words, right, right_words, out, karatsuba_threshold_.load(std::memory_order_relaxed), base_case());
+}
@@ -0,0 +1,49 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLMUL_H
+#define CLMUL_H
+
+#include <cstdint>
+
+/**
+ * Carry-less (GF(2)[x]) multiplication of polynomials stored as 64 bit words, least significant word first.
+ * Uses PCLMULQDQ when the running CPU supports it and a portable 64x64 kernel otherwise.
+ * Operands of at least karatsuba_threshold() words are split with Karatsuba.
+ */
+
+//out must have room for left_words + right_words words and must not alias the inputs.
+void clmul_words(const uint64_t* left, uint32_t left_words, const uint64_t* right, uint32_t right_words, uint64_t* out);
+
+uint32_t karatsuba_threshold();
+
+void set_karatsuba_threshold(uint32_t words);
+
+//True if the PCLMULQDQ kernel is in use.
+bool clmul_hardware_support();
+
+enum class clmul_kernel {
+    portable,
+    pclmul
+};
+
+//Replaces the kernel picked at startup, so tests can cover every one the CPU supports. Returns false, changing
+//nothing, if the CPU lacks it. Only meant for testing.
+bool set_clmul_kernel(clmul_kernel kernel);
+
+#endif // CLMUL_H
@@ -17,19 +17,25 @@
  */
 
 #include "galoisfield.h"
+#include "staticgaloisfield.h"
+#include <array>
+#include <cstddef>
+#include <utility>
 
-uint8_t GaloisField::primitive_polinomial_[8] = {0, 0, 0b00000011, 0b00000011, 0, 0, 0, 0b00011101};
-GaloisField::count_log_anti_log_tables GaloisField::tables_[8] = {};
+struct field_tables_ {
+    const uint16_t* log_table;
+    const uint16_t* anti_log_table;
+};
 
-static uint8_t degree(uint8_t number) {
-    uint8_t ret = 0;
-    while(number) {
-        number >>= 1;
-        ++ret;
-    }
-    return ret;
+//StaticGaloisField's log table is indexed by the element itself, ours by element - 1.
+template<std::size_t... I>
+static constexpr std::array<field_tables_, 16> make_field_tables_(std::index_sequence<I...>) {
+    return {{ {StaticGaloisField<I + 1>::tables.log + 1, StaticGaloisField<I + 1>::tables.anti_log}... }};
 }
 
+//Constant initialised and never written, so no locking or reference counting is needed.
+static constexpr std::array<field_tables_, 16> tables_ = make_field_tables_(std::make_index_sequence<16>());
+
 template<typename T>
 static void swap_(T& left, T& right) {
     T tmp = left;
@@ -37,23 +43,17 @@ static void swap_(T& left, T& right) {
     right = tmp;
 } 
 
-GaloisField::GaloisField(const GaloisField& gf): size_(gf.size_), number_(gf.number_) {
-    gen_log_tables_();
-}
-
 GaloisField::GaloisField(uint8_t size): size_(size), number_(0) {
-    gen_log_tables_();
 }
 
-GaloisField::GaloisField(uint8_t size, uint8_t number): size_(size), number_(0) {
+GaloisField::GaloisField(uint8_t size, uint16_t number): size_(size), number_(0) {
     while(size) {
         number_ |= (number & (1 << (size - 1)));
         --size;
     }
-    gen_log_tables_();
 }
 
-GaloisField& GaloisField::operator=(uint8_t number) {
+GaloisField& GaloisField::operator=(uint16_t number) {
     uint8_t size = size_;
     number_ = 0;
     while(size) {
@@ -63,24 +63,11 @@ GaloisField& GaloisField::operator=(uint8_t number) {
     return *this;
 }
 
-GaloisField& GaloisField::operator=(const GaloisField& other) {
-    GaloisField tmp(other);
-    swap(tmp);
-    return *this;
-}
-
 void GaloisField::swap(GaloisField& other) {
     swap_(this->size_, other.size_);
     swap_(this->number_, other.number_);
 }
 
-GaloisField::~GaloisField() {
-    --tables_[size_ - 1].count;
-    if(!tables_[size_ - 1].count) {
-        delete[] tables_[size_ - 1].log_table;
-        delete[] tables_[size_ - 1].anti_log_table;
-    }
-}
 
 GaloisField& GaloisField::operator*=(const GaloisField& rhs) {
     if(size_ == rhs.size_) {
@@ -89,119 +76,90 @@ GaloisField& GaloisField::operator*=(const GaloisField& rhs) {
     return *this;
 }
 
-GaloisField& GaloisField::GaloisField::operator/=(const GaloisField& rhs) {
-    if(size_ == rhs.size_) {
-        uint8_t q, r;
-        long_division_(rhs, q, r);
-        number_ = q;
+GaloisField& GaloisField::operator/=(const GaloisField& rhs) {
+    if(size_ == rhs.size_ && rhs.number_) {
+        number_ = divide_(number_, rhs.number_);
     }
     return *this;
 }
 
+//Every non zero element divides every other one, so the remainder is always zero.
 GaloisField & GaloisField::operator%=(const GaloisField& rhs) {
-    if(size_ == rhs.size_) {
-        uint8_t q, r;
-        long_division_(rhs, q, r);
-        number_ = r;
+    if(size_ == rhs.size_ && rhs.number_) {
+        number_ = 0;
     }
     return *this;
 }
 
-void GaloisField::long_division_(const GaloisField& rhs, uint8_t& q, uint8_t& r) {
-    uint8_t q_ = 0;
-    uint8_t r_ = number_;
-    uint8_t tmp = 0;
-    while(r_) {
-        int16_t degree_dif = static_cast<int16_t>(degree(r_)) - static_cast<int16_t>(degree(rhs.number_));
-        if(degree_dif < 0) break;
-        tmp = (1 << (degree_dif));
-        q_ ^= tmp;
-        r_ ^= multiply_(rhs.number_, tmp);
+GaloisField GaloisField::inverse() const {
+    GaloisField tmp(*this);
+    if(number_) {
+        tmp.number_ = divide_(1, number_);
     }
-    r = r_;
-    q = q_;
-}
-
-uint8_t GaloisField::gen_poly() const {
-    return primitive_polinomial_[size_ - 1];
+    return tmp;
 }
 
-uint8_t GaloisField::multiply_(uint8_t number, uint8_t other) {
-    uint32_t tmp = 0;
-    while(other) {
-        if(other % 2) {
-            tmp ^= number;
-        }
-        other >>= 1;
-        bool flip = (number & (1 << (size_ - 1)));
-        number <<= 1;
-        if(flip) {
-            number ^= primitive_polinomial_[size_ - 1];
-        }
+GaloisField GaloisField::pow(uint32_t exponent) const {
+    GaloisField tmp(*this);
+    if(number_) {
+        uint32_t order = (1 << size_) - 1;
+        uint64_t log = tables_[size_ - 1].log_table[number_ - 1];
+        tmp.number_ = tables_[size_ - 1].anti_log_table[(log * exponent) % order];
     }
-    tmp &= (1 << static_cast<uint32_t>(size_)) - 1;
-    number = tmp;
-    return number;
-}
-
-void GaloisField::gen_log_tables_() {
-    if(!tables_[size_ - 1].count) {
-        uint8_t current_calc = 1;
-        uint8_t step = 2;
-        tables_[size_ - 1].log_table = new uint8_t[(1 << size_) - 1];
-        tables_[size_ - 1].anti_log_table = new uint8_t[(1 << size_) - 1];
-        for(uint32_t i = 0; i < (1 << size_) - 1; ++i) {
-            tables_[size_ - 1].log_table[i] = current_calc;
-            tables_[size_ - 1].anti_log_table[current_calc - 1] = i;
-            current_calc = multiply_(current_calc, step);
-        }
+    else {
+        tmp.number_ = exponent ? 0 : 1;
     }
-    ++tables_[size_ - 1].count;
+    return tmp;
+}
+
+uint16_t GaloisField::gen_poly() const {
+    return primitive_polynomials[size_ - 1];
+}
+
+const uint16_t* GaloisField::log_table() const {
+    return tables_[size_ - 1].log_table;
 }
 
-uint32_t GaloisField::minimal_polinomial(uint8_t polinomial_number) const {
-    uint32_t linear_system[size_];
-    for(uint8_t i = 0; i < size_; ++i) {
-        linear_system[i] = 0;
+const uint16_t* GaloisField::anti_log_table() const {
+    return tables_[size_ - 1].anti_log_table;
+}
+
+uint16_t GaloisField::multiply_(uint16_t number, uint16_t other) const {
+    if(!number || !other) {
+        return 0;
     }
-    for(uint8_t bit_num = 0; bit_num < 8; ++bit_num) {
-        for(uint8_t i = 0; i <= size_; ++i) {
-            if(tables_[size_ - 1].log_table[(i * polinomial_number) % ((1 << size_) - 1)] & (1 << bit_num)) {
-                linear_system[bit_num] |= static_cast<uint32_t>(1 << ((i + 1) % (size_ + 1)));
-            }
-        }
+    const field_tables_& tables = tables_[size_ - 1];
+    return tables.anti_log_table[tables.log_table[number - 1] + tables.log_table[other - 1]];
+}
+
+uint16_t GaloisField::divide_(uint16_t number, uint16_t other) const {
+    if(!number) {
+        return 0;
     }
-    //Apply row reduction algorithm to generate row echelon form
-    uint32_t h = 0, k = 0;
-    uint32_t base = 1 << size_;
-    while(h < size_ && k < size_) {
-        for(uint32_t i = h; i < size_; ++i) {
-            if(linear_system[i] & (base >> k)) {
-                swap_(linear_system[h], linear_system[i]);
-                for(uint32_t j = h + 1; j < size_; ++j) {
-                    if(linear_system[j] & (base >> k)) {
-                        linear_system[j] ^= linear_system[h];
-                    }
-                }
-                ++h;
-                break;
-            }
+    const field_tables_& tables = tables_[size_ - 1];
+    return tables.anti_log_table[tables.log_table[number - 1] + ((1 << size_) - 1) - tables.log_table[other - 1]];
+}
+
+uint32_t GaloisField::minimal_polinomial(uint16_t polinomial_number) const {
+    //Product of (x - alpha^c) over the cyclotomic coset c = polinomial_number * 2^i mod 2^m - 1.
+    //Its coefficients are in GF(2) even though the arithmetic is done in the field.
+    const uint32_t order = (1 << size_) - 1;
+    const uint32_t first = polinomial_number % order;
+    uint16_t coefficients[17] = {1};
+    uint32_t degree = 0;
+    uint32_t conjugate = first;
+    do {
+        uint16_t root = tables_[size_ - 1].anti_log_table[conjugate];
+        ++degree;
+        for(uint32_t i = degree; i > 0; --i) {
+            coefficients[i] = coefficients[i - 1] ^ multiply_(coefficients[i], root);
         }
-        ++k;
-    }
+        coefficients[0] = multiply_(coefficients[0], root);
+        conjugate = (2 * conjugate) % order;
+    } while(conjugate != first);
     uint32_t ret = 0;
-    for(uint8_t i = 1; i < size_ + 1; ++i) {
-        uint8_t index = size_ - i;
-        uint8_t bit_calc = linear_system[index] & 1;
-        for(uint8_t j = i - 1; j > 0; --j) {
-            //If the bit is set, we get its value. We have to xor it to the result so we can compute the resulting bit value;
-            if(linear_system[index] & (1 << j) && ret & (1 << j)) {
-                bit_calc ^= 1;
-            }
-        }
-        ret |= (bit_calc << i);
+    for(uint32_t i = 0; i <= degree; ++i) {
+        ret |= static_cast<uint32_t>(coefficients[i] & 1) << i;
     }
-    ret >>= 1;
-    ret |= 1 << size_;
     return ret;
 }
@@ -22,16 +22,18 @@
 #include <cstdint>
 
 /**
- * @todo write docs
+ * Element of GF(2^size), size in [1, 16]. Elements are polynomials over GF(2) reduced by primitive_polynomials[size - 1].
+ * The log/anti log tables are the constexpr ones of StaticGaloisField<size>, so elements are plain values
+ * that can be created and copied from any thread.
  */
 class GaloisField {
 public:
     explicit GaloisField(uint8_t size);
-    explicit GaloisField(uint8_t size, uint8_t number);
-    GaloisField(const GaloisField&);
-    ~GaloisField();
-    GaloisField& operator=(uint8_t number);
-    GaloisField& operator=(const GaloisField&);
+    explicit GaloisField(uint8_t size, uint16_t number);
+    GaloisField(const GaloisField&) = default;
+    ~GaloisField() = default;
+    GaloisField& operator=(uint16_t number);
+    GaloisField& operator=(const GaloisField&) = default;
     GaloisField& operator+=(const GaloisField& rhs) {
         if(rhs.size_ == size_) {
             number_ ^= rhs.number_;
@@ -75,29 +77,31 @@ public:
         return size_;
     }
     
-    uint8_t gen_poly() const;
+    uint16_t gen_poly() const;
     
-    explicit operator uint8_t() const {
+    explicit operator uint16_t() const {
         return number_;
     }
     
     void swap(GaloisField& other);
     
-    uint32_t minimal_polinomial(uint8_t polinomial_number) const;
+    GaloisField inverse() const;
+    
+    GaloisField pow(uint32_t exponent) const;
+    
+    uint32_t minimal_polinomial(uint16_t polinomial_number) const;
+    
+    //log_table()[v - 1] is the discrete logarithm of v and has 2^size - 1 entries.
+    //anti_log_table()[i] is alpha^i for i < 2 * (2^size - 1), so the sum of two logarithms needs no modulo.
+    const uint16_t* log_table() const;
+    
+    const uint16_t* anti_log_table() const;
     
 private:
-    struct count_log_anti_log_tables {
-        uint32_t count = 0;
-        uint8_t* log_table = nullptr;
-        uint8_t* anti_log_table = nullptr;
-    };
-    void long_division_(const GaloisField&, uint8_t&, uint8_t&);
-    uint8_t multiply_(uint8_t number, uint8_t other);
-    void gen_log_tables_();
+    uint16_t multiply_(uint16_t number, uint16_t other) const;
+    uint16_t divide_(uint16_t number, uint16_t other) const;
     uint8_t size_;
-    uint8_t number_;
-    static uint8_t primitive_polinomial_[8];
-    static count_log_anti_log_tables tables_[8];
+    uint16_t number_;
 };
 
 #endif // GALOISFIELD_H
@@ -0,0 +1,274 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gfbulk.h"
+#include "scratcharena.h"
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GFBULK_X86_
+#endif
+
+//For a constant c, lo[q][v] and hi[q][v] are the low and high bytes of c * (v << 4q).
+struct nibble_tables_ {
+    uint8_t lo[4][16];
+    uint8_t hi[4][16];
+};
+
+typedef void (*region_kernel_)(const nibble_tables_&, const uint16_t*, uint16_t*, std::size_t, bool);
+
+static void build_nibble_tables_(const GaloisField& field, uint16_t constant, nibble_tables_& tables) {
+    const uint16_t* log = field.log_table();
+    const uint16_t* anti_log = field.anti_log_table();
+    const uint32_t constant_log = log[constant - 1];
+    for(uint32_t q = 0; q < 4; ++q) {
+        for(uint32_t v = 0; v < 16; ++v) {
+            uint32_t element = v << (4 * q);
+            uint16_t product = 0;
+            if(v && element < (1u << field.size())) {
+                product = anti_log[log[element - 1] + constant_log];
+            }
+            tables.lo[q][v] = product & 0xFF;
+            tables.hi[q][v] = product >> 8;
+        }
+    }
+}
+
+//Scalar tail shared by every kernel: the tables hold the same products as the log lookup.
+static void region_scalar_(const nibble_tables_& tables, const uint16_t* src, uint16_t* dst, std::size_t count, bool accumulate) {
+    for(std::size_t i = 0; i < count; ++i) {
+        uint16_t value = src[i];
+        uint16_t product = 0;
+        for(uint32_t q = 0; q < 4; ++q) {
+            uint32_t nibble = (value >> (4 * q)) & 0xF;
+            product ^= tables.lo[q][nibble] | (tables.hi[q][nibble] << 8);
+        }
+        dst[i] = accumulate ? dst[i] ^ product : product;
+    }
+}
+
+#ifdef GFBULK_X86_
+__attribute__((target("ssse3")))
+static void region_ssse3_(const nibble_tables_& tables, const uint16_t* src, uint16_t* dst, std::size_t count, bool accumulate) {
+    __m128i lo[4], hi[4];
+    for(uint32_t q = 0; q < 4; ++q) {
+        lo[q] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.lo[q]));
+        hi[q] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.hi[q]));
+    }
+    const __m128i low_byte = _mm_set1_epi16(0x00FF);
+    const __m128i low_nibble = _mm_set1_epi8(0x0F);
+    std::size_t i = 0;
+    for(; i + 16 <= count; i += 16) {
+        __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+        __m128i low_bytes = _mm_packus_epi16(_mm_and_si128(first, low_byte), _mm_and_si128(second, low_byte));
+        __m128i high_bytes = _mm_packus_epi16(_mm_srli_epi16(first, 8), _mm_srli_epi16(second, 8));
+        __m128i nibbles[4] = {
+            _mm_and_si128(low_bytes, low_nibble),
+            _mm_and_si128(_mm_srli_epi16(low_bytes, 4), low_nibble),
+            _mm_and_si128(high_bytes, low_nibble),
+            _mm_and_si128(_mm_srli_epi16(high_bytes, 4), low_nibble)
+        };
+        __m128i result_lo = _mm_setzero_si128();
+        __m128i result_hi = _mm_setzero_si128();
+        for(uint32_t q = 0; q < 4; ++q) {
+            result_lo = _mm_xor_si128(result_lo, _mm_shuffle_epi8(lo[q], nibbles[q]));
+            result_hi = _mm_xor_si128(result_hi, _mm_shuffle_epi8(hi[q], nibbles[q]));
+        }
+        __m128i out_first = _mm_unpacklo_epi8(result_lo, result_hi);
+        __m128i out_second = _mm_unpackhi_epi8(result_lo, result_hi);
+        if(accumulate) {
+            out_first = _mm_xor_si128(out_first, _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i)));
+            out_second = _mm_xor_si128(out_second, _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i + 8)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), out_first);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), out_second);
+    }
+    region_scalar_(tables, src + i, dst + i, count - i, accumulate);
+}
+
+//Same as the SSSE3 kernel on 32 elements; pack and unpack both work per 128 bit lane, so element order is kept.
+__attribute__((target("avx2")))
+static void region_avx2_(const nibble_tables_& tables, const uint16_t* src, uint16_t* dst, std::size_t count, bool accumulate) {
+    __m256i lo[4], hi[4];
+    for(uint32_t q = 0; q < 4; ++q) {
+        lo[q] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.lo[q])));
+        hi[q] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.hi[q])));
+    }
+    const __m256i low_byte = _mm256_set1_epi16(0x00FF);
+    const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+    std::size_t i = 0;
+    for(; i + 32 <= count; i += 32) {
+        __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 16));
+        __m256i low_bytes = _mm256_packus_epi16(_mm256_and_si256(first, low_byte), _mm256_and_si256(second, low_byte));
+        __m256i high_bytes = _mm256_packus_epi16(_mm256_srli_epi16(first, 8), _mm256_srli_epi16(second, 8));
+        __m256i nibbles[4] = {
+            _mm256_and_si256(low_bytes, low_nibble),
+            _mm256_and_si256(_mm256_srli_epi16(low_bytes, 4), low_nibble),
+            _mm256_and_si256(high_bytes, low_nibble),
+            _mm256_and_si256(_mm256_srli_epi16(high_bytes, 4), low_nibble)
+        };
+        __m256i result_lo = _mm256_setzero_si256();
+        __m256i result_hi = _mm256_setzero_si256();
+        for(uint32_t q = 0; q < 4; ++q) {
+            result_lo = _mm256_xor_si256(result_lo, _mm256_shuffle_epi8(lo[q], nibbles[q]));
+            result_hi = _mm256_xor_si256(result_hi, _mm256_shuffle_epi8(hi[q], nibbles[q]));
+        }
+        __m256i out_first = _mm256_unpacklo_epi8(result_lo, result_hi);
+        __m256i out_second = _mm256_unpackhi_epi8(result_lo, result_hi);
+        if(accumulate) {
+            out_first = _mm256_xor_si256(out_first, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i)));
+            out_second = _mm256_xor_si256(out_second, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i + 16)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), out_first);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 16), out_second);
+    }
+    region_ssse3_(tables, src + i, dst + i, count - i, accumulate);
+}
+#endif
+
+static bool kernel_supported_(gf_region_kernel kernel) {
+#ifdef GFBULK_X86_
+    __builtin_cpu_init();
+    if(kernel == gf_region_kernel::avx2) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if(kernel == gf_region_kernel::ssse3) {
+        return __builtin_cpu_supports("ssse3");
+    }
+#endif
+    return kernel == gf_region_kernel::scalar;
+}
+
+static region_kernel_ kernel_function_(gf_region_kernel kernel) {
+#ifdef GFBULK_X86_
+    if(kernel == gf_region_kernel::avx2) {
+        return region_avx2_;
+    }
+    if(kernel == gf_region_kernel::ssse3) {
+        return region_ssse3_;
+    }
+#endif
+    return region_scalar_;
+}
+
+static region_kernel_ select_region_kernel_() {
+    for(gf_region_kernel kernel : {gf_region_kernel::avx2, gf_region_kernel::ssse3}) {
+        if(kernel_supported_(kernel)) {
+            return kernel_function_(kernel);
+        }
+    }
+    return region_scalar_;
+}
+
+static std::atomic<region_kernel_>& selected_region_kernel_() {
+    static std::atomic<region_kernel_> selected(select_region_kernel_());
+    return selected;
+}
+
+static region_kernel_ region_kernel() {
+    return selected_region_kernel_().load(std::memory_order_relaxed);
+}
+
+bool set_gf_region_kernel(gf_region_kernel kernel) {
+    if(!kernel_supported_(kernel)) {
+        return false;
+    }
+    selected_region_kernel_().store(kernel_function_(kernel), std::memory_order_relaxed);
+    return true;
+}
+
+//Below this many elements building the nibble tables costs more than it saves.
+static const std::size_t table_threshold_ = 16;
+
+static void region_(const GaloisField& field, uint16_t constant, const uint16_t* src, uint16_t* dst, std::size_t count, bool accumulate) {
+    if(!constant) {
+        if(!accumulate) {
+            for(std::size_t i = 0; i < count; ++i) {
+                dst[i] = 0;
+            }
+        }
+        return;
+    }
+    if(count < table_threshold_) {
+        const uint16_t* log = field.log_table();
+        const uint16_t* anti_log = field.anti_log_table();
+        const uint32_t constant_log = log[constant - 1];
+        for(std::size_t i = 0; i < count; ++i) {
+            uint16_t product = src[i] ? anti_log[log[src[i] - 1] + constant_log] : 0;
+            dst[i] = accumulate ? dst[i] ^ product : product;
+        }
+        return;
+    }
+    nibble_tables_ tables;
+    build_nibble_tables_(field, constant, tables);
+    region_kernel()(tables, src, dst, count, accumulate);
+}
+
+void gf_multiply_region(const GaloisField& field, uint16_t constant, const uint16_t* src, uint16_t* dst, std::size_t count) {
+    region_(field, constant, src, dst, count, false);
+}
+
+void gf_multiply_accumulate_region(const GaloisField& field, uint16_t constant, const uint16_t* src, uint16_t* dst, std::size_t count) {
+    region_(field, constant, src, dst, count, true);
+}
+
+void gf_evaluate_powers(const GaloisField& field, const uint16_t* polynomial, uint32_t degree, uint32_t first, uint32_t step, uint16_t* out, std::size_t count) {
+    const uint16_t* log = field.log_table();
+    const uint16_t* anti_log = field.anti_log_table();
+    const uint64_t order = (1 << field.size()) - 1;
+    //Points are handled in blocks of width points. For block b, term i is
+    //p_i * alpha^(i * (first + b * width * step)) times base[i][j] = alpha^(i * step * j),
+    //so a block is one multiply-accumulate by a constant per coefficient.
+    const std::size_t width = count < 256 ? count : 256;
+    if(!width) {
+        return;
+    }
+    ScratchBuffer<uint16_t> base((degree + 1) * width);
+    ScratchBuffer<uint64_t> exponents(degree + 1, order);
+    for(uint32_t i = 0; i <= degree; ++i) {
+        uint64_t increment = (static_cast<uint64_t>(i) * step) % order;
+        uint64_t exponent = 0;
+        for(std::size_t j = 0; j < width; ++j) {
+            base[i * width + j] = anti_log[exponent];
+            exponent += increment;
+            if(exponent >= order) {
+                exponent -= order;
+            }
+        }
+        if(polynomial[i]) {
+            exponents[i] = (log[polynomial[i] - 1] + static_cast<uint64_t>(i) * first) % order;
+        }
+    }
+    for(std::size_t offset = 0; offset < count; offset += width) {
+        std::size_t block = count - offset < width ? count - offset : width;
+        uint16_t* block_out = out + offset;
+        for(std::size_t j = 0; j < block; ++j) {
+            block_out[j] = 0;
+        }
+        for(uint32_t i = 0; i <= degree; ++i) {
+            if(exponents[i] == order) {
+                continue;
+            }
+            gf_multiply_accumulate_region(field, anti_log[exponents[i]], &base[i * width], block_out, block);
+            exponents[i] = (exponents[i] + static_cast<uint64_t>(i) * step % order * width) % order;
+        }
+    }
+}
@@ -0,0 +1,52 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GFBULK_H
+#define GFBULK_H
+
+#include "galoisfield.h"
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Bulk arithmetic over contiguous arrays of GF(2^m) elements, m being field.size(); the value of field is ignored.
+ * Multiplication by a constant uses split nibble tables with PSHUFB (AVX2 or SSSE3, picked at runtime)
+ * and falls back to log/anti log lookups.
+ */
+
+//dst[i] = constant * src[i]. src and dst may be the same array.
+void gf_multiply_region(const GaloisField& field, uint16_t constant, const uint16_t* src, uint16_t* dst, std::size_t count);
+
+//dst[i] ^= constant * src[i].
+void gf_multiply_accumulate_region(const GaloisField& field, uint16_t constant, const uint16_t* src, uint16_t* dst, std::size_t count);
+
+//out[j] = polynomial(alpha^(first + j * step)) for j < count, polynomial having degree + 1 coefficients.
+//Exponents are taken modulo 2^m - 1, so step = 2^m - 2 walks alpha^-j as the Chien search does.
+void gf_evaluate_powers(const GaloisField& field, const uint16_t* polynomial, uint32_t degree, uint32_t first, uint32_t step, uint16_t* out, std::size_t count);
+
+enum class gf_region_kernel {
+    scalar,
+    ssse3,
+    avx2
+};
+
+//Replaces the region kernel picked at startup, so tests can cover every one the CPU supports. Returns false,
+//changing nothing, if the CPU lacks it. Only meant for testing.
+bool set_gf_region_kernel(gf_region_kernel kernel);
+
+#endif // GFBULK_H
@@ -1,15 +1,20 @@
 #include "galoisfield.h"
 #include "bitvector.h"
 #include "bch.h"
+#include "threadpool.h"
+#include "chacha20.h"
+#include "blockcode.h"
+#include "mappedfile.h"
+#include "sketchcontainer.h"
+#include "polynomialcache.h"
 #include <iostream>
 #include <algorithm>
-#include <bitset>
+#include <cstdlib>
 #include <string>
-#include <fstream>
 #include <vector>
-#include <iterator>
-#include <cmath>
-#include <random>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
 
 #ifndef EXIT_FAILURE
 #define EXIT_FAILURE 1
@@ -25,37 +30,27 @@ static void help(std::ostream& os) {
     os << "  [mandatory] provide file name to create the secure sketch." << std::endl;
     os << "--number_errors || -t" << std::endl;
     os << "  [optional] the number of bits that can differ between inputs." << std::endl;
-    os << "    -if not supplied this is equal to 10% of the size of the file." << std::endl;
+    os << "    -if not supplied this is equal to 10% of the size of a block in bits, capped at (block bits - 1) / m." << std::endl;
+    os << "    -the code takes up to m bits of parity per error, which must leave at least one bit for the message." << std::endl;
+    os << "--block_order || -m" << std::endl;
+    os << "  [optional] order of the Galois field of each block, between 4 and 16." << std::endl;
+    os << "    -the file is split in blocks of (2^m - 1) / 8 bytes, each protected by its own codeword." << std::endl;
+    os << "    -if not supplied the smallest order up to 8 holding the whole file is used, or 8 for larger files." << std::endl;
     os << "--number_secure_sketch || -s" << std::endl;
     os << "  [optional] the number of secure sketches to generate." << std::endl;
     os << "    -if not supplied this is equal to 1." << std::endl;
     os << "--output_file || -of" << std::endl;
     os << "  [mandatory] prefix of the name of the files to save the secure sketches." << std::endl;
-}
-
-void write(const std::string& file_prefix, uint32_t cur, const std::vector<char>& out) {
-    std::ofstream file(file_prefix + std::to_string(cur));
-    for(char c : out) {
-        file << c;
-    }
-}
-
-std::vector<char> random_byte_array(uint32_t bytes, uint8_t bit_offset) {
-    std::vector<char> ret;
-    std::random_device engine;
-    uint32_t x = 0;
-    for(uint32_t i = 0; i < bytes; ++i) {
-        if(i % 4) {
-            x = engine();
-        }
-        ret.push_back(x & (1 << ((sizeof(char) * 8))) - 1);
-        x >>= (sizeof(char) * 8);
-    }
-    if(bit_offset) {
-        x = engine();
-        ret.push_back(x & ((1 << (bit_offset)) - 1));
-    }
-    return ret;
+    os << "--container || -c" << std::endl;
+    os << "  [optional] save all secure sketches to a single indexed container file named by --output_file." << std::endl;
+    os << "--code_cache" << std::endl;
+    os << "  [optional] file caching generator polynomials between runs. Created if it doesn't exist." << std::endl;
+    os << "--seed" << std::endl;
+    os << "  [optional] seed for reproducible secure sketches. Only meant for testing." << std::endl;
+    os << "    -if not supplied the random messages are keyed from std::random_device." << std::endl;
+    os << "--threads || -j" << std::endl;
+    os << "  [optional] the number of threads generating secure sketches." << std::endl;
+    os << "    -if not supplied this is equal to the number of hardware threads." << std::endl;
 }
 
 int main(int argc, char **argv) {
@@ -66,8 +61,14 @@ int main(int argc, char **argv) {
     }
     std::string file_name;
     std::string output_file_name;
+    std::string cache_file_name;
     uint32_t number_secure_sketch = 0;
     uint32_t number_errors = 0;
+    uint32_t number_threads = 0;
+    uint32_t block_order = 0;
+    bool seeded = false;
+    bool packed = false;
+    uint64_t seed = 0;
     for(int i = 1; i < argc; ++i) {
         std::string arg(argv[i]);
         if(arg == "--input_file" || arg == "-if") {
@@ -136,6 +137,81 @@ int main(int argc, char **argv) {
             }
             output_file_name = argv[i];
         }
+        else if(arg == "--block_order" || arg == "-m") {
+            if((++i) == argc) {
+                std::cerr << "Missing argument after " << arg << std::endl;
+                return EXIT_FAILURE;
+            }
+            if(block_order) {
+                std::cerr << "Block order is already set." << std::endl;
+                return EXIT_FAILURE;
+            }
+            char* next;
+            long read = 0;
+            read = std::strtol(argv[i], &next, 0);
+            if(*next) {
+                std::cerr << "Invalid parsing. " << argv[i] << " is not a number." << std::endl;
+                return EXIT_FAILURE;
+            }
+            if(read < 4 || read > 16) {
+                std::cerr << read << " is not a valid block order." << std::endl;
+                return EXIT_FAILURE;
+            }
+            block_order = static_cast<uint32_t>(read);
+        }
+        else if(arg == "--code_cache") {
+            if((++i) == argc) {
+                std::cerr << "Missing argument after " << arg << std::endl;
+                return EXIT_FAILURE;
+            }
+            if(!cache_file_name.empty()) {
+                std::cerr << "Can't use more than 1 code cache." << std::endl;
+                return EXIT_FAILURE;
+            }
+            cache_file_name = argv[i];
+        }
+        else if(arg == "--container" || arg == "-c") {
+            packed = true;
+        }
+        else if(arg == "--seed") {
+            if((++i) == argc) {
+                std::cerr << "Missing argument after " << arg << std::endl;
+                return EXIT_FAILURE;
+            }
+            if(seeded) {
+                std::cerr << "Seed is already set." << std::endl;
+                return EXIT_FAILURE;
+            }
+            char* next;
+            seed = std::strtoull(argv[i], &next, 0);
+            if(*next || argv[i][0] == '-') {
+                std::cerr << "Invalid parsing. " << argv[i] << " is not a number." << std::endl;
+                return EXIT_FAILURE;
+            }
+            seeded = true;
+        }
+        else if(arg == "--threads" || arg == "-j") {
+            if((++i) == argc) {
+                std::cerr << "Missing argument after " << arg << std::endl;
+                return EXIT_FAILURE;
+            }
+            if(number_threads) {
+                std::cerr << "Number of threads is already set." << std::endl;
+                return EXIT_FAILURE;
+            }
+            char* next;
+            long read = 0;
+            read = std::strtol(argv[i], &next, 0);
+            if(*next) {
+                std::cerr << "Invalid parsing. " << argv[i] << " is not a number." << std::endl;
+                return EXIT_FAILURE;
+            }
+            if(read < 1) {
+                std::cerr << read << " is not a valid number." << std::endl;
+                return EXIT_FAILURE;
+            }
+            number_threads = static_cast<uint32_t>(read);
+        }
         else if(arg == "--help" || arg == "-h") {
             help(std::cout);
             return EXIT_SUCCESS;
@@ -149,6 +225,9 @@ int main(int argc, char **argv) {
     if(!number_secure_sketch) {
         number_secure_sketch = 1;
     }
+    if(!number_threads) {
+        number_threads = ThreadPool::hardware_threads();
+    }
     if(file_name.empty()) {
         std::cerr << "Missing input file." << std::endl;
         return EXIT_FAILURE;
@@ -157,37 +236,150 @@ int main(int argc, char **argv) {
         std::cerr << "Missing output file prefix." << std::endl;
         return EXIT_FAILURE;
     }
-    std::ifstream input_file(file_name);
+    MappedFile input_file(file_name);
     if(!input_file) {
         std::cerr << "Couldn't open file " << file_name << std::endl;
         return EXIT_FAILURE;
     }
-    std::vector<char> buffer((std::istreambuf_iterator<char>(input_file)), std::istreambuf_iterator<char>());
-    std::size_t buffer_size = buffer.size() * 8;
+    const uint8_t* input = input_file.data();
+    const std::size_t input_bytes = input_file.size();
+    if(!input_bytes) {
+        std::cerr << "File " << file_name << " is empty." << std::endl;
+        return EXIT_FAILURE;
+    }
+    if(!block_order) {
+        //A single codeword if the file fits one of order up to 8, blocks of order 8 otherwise.
+        block_order = 4;
+        while(block_order < 8 && ((1u << block_order) - 1) / 8 < input_bytes) {
+            ++block_order;
+        }
+    }
+    //Blocks are made as even as possible and the code is shortened to exactly one block, so no bits of the
+    //codewords are spent on padding past the input.
+    const uint32_t full_block_bytes = ((1u << block_order) - 1) / 8;
+    const uint64_t block_count = (input_bytes + full_block_bytes - 1) / full_block_bytes;
+    const uint32_t block_bits = (input_bytes + block_count - 1) / block_count * 8;
     if(!number_errors) {
-        //Assume number of errors as 10% the size of the file in bits.
-        number_errors = buffer_size / 10;
+        //Assume number of errors as 10% the size of a block in bits, as long as the m * t parity bits the generator
+        //can have leave room for a message.
+        number_errors = std::max<uint32_t>(std::min<uint32_t>(block_bits / 10, (block_bits - 1) / block_order), 1);
+    }
+    //A file that exists but isn't a valid cache is never overwritten: it may well be something else entirely.
+    bool cache_writable = !cache_file_name.empty();
+    if(cache_writable && MappedFile(cache_file_name) && !PolynomialCache::instance().load(cache_file_name)) {
+        std::cerr << "Ignoring invalid code cache " << cache_file_name << ", it won't be updated." << std::endl;
+        cache_writable = false;
     }
-    uint8_t gf_order = std::ceil(std::log2(buffer_size));
-    if(gf_order > 8) {
-        std::cerr << "Galois field of order greater than 8 are not yet permited." << std::endl;
+    GaloisField field(block_order);
+    BCH encoder(field, number_errors, block_bits);
+    if(cache_writable && PolynomialCache::instance().modified() && !PolynomialCache::instance().save(cache_file_name)) {
+        std::cerr << "Couldn't write file " << cache_file_name << std::endl;
         return EXIT_FAILURE;
     }
-    GaloisField field(gf_order);
-    BCH encoder(field, number_errors);
-    uint32_t enc_bits = encoder.generator_order();
-    uint32_t total_bits = 1 << gf_order;
-    uint32_t dif = total_bits - enc_bits;
-    uint32_t num_bytes = dif / 8 + 1;
-    uint8_t bit_offset = dif % 8;
-    BitVector input_data_bit_vector(buffer.begin(), buffer.end());
-    for(uint32_t i = 0; i < number_secure_sketch; ++i) {
-        std::vector<char> random_data = random_byte_array(num_bytes, bit_offset);
-        BitVector data_vector(random_data.begin(), random_data.end());
-        BitVector encoded = encoder.encode(data_vector);
-        encoded ^= input_data_bit_vector;
-        std::vector<char> output_array(encoded.begin(), encoded.end());
-        write(output_file_name, i, output_array);
+    if(!encoder) {
+        std::cerr << "Can't correct " << number_errors << " errors in blocks of order " << block_order << "." << std::endl;
+        return EXIT_FAILURE;
+    }
+    BlockCode code(encoder);
+    const uint32_t message_bits = encoder.message_length();
+    const uint32_t message_bytes = code.message_bytes();
+    const uint64_t blocks = code.blocks(input_bytes);
+    const std::size_t sketch_bytes = code.sketch_bytes(input_bytes);
+    //Sketches are generated in chunks of whole sketches by the pool, each worker with its own copy of the code,
+    //while this thread writes the chunks in order as they finish. A chunk holds enough sketches for a full
+    //encode_batch group, so small inputs are batched across sketches, and a sketch of more blocks than that is
+    //split into parts of one group each, so its blocks are still spread over the workers. Only slots chunks are
+    //in flight at a time, each in its own buffer that is reused once the chunk is written, so memory doesn't
+    //grow with the output.
+    //Part p of chunk c draws its random messages from ChaCha20 stream c * chunk_parts + p, so the output only
+    //depends on the key and not on how the work is spread over the workers.
+    const uint64_t chunk_sketches = std::max<uint64_t>(1, (BlockCode::group_blocks + blocks - 1) / blocks);
+    const uint64_t chunks = (number_secure_sketch + chunk_sketches - 1) / chunk_sketches;
+    const uint64_t part_blocks = std::min<uint64_t>(blocks, BlockCode::group_blocks);
+    const uint64_t chunk_parts = (blocks + part_blocks - 1) / part_blocks;
+    const uint64_t slots = std::min<uint64_t>(chunks, 4 * uint64_t(number_threads));
+    std::vector<BlockCode> codes(number_threads, code);
+    uint32_t key[ChaCha20::key_words] = {};
+    if(seeded) {
+        key[0] = static_cast<uint32_t>(seed);
+        key[1] = static_cast<uint32_t>(seed >> 32);
+    }
+    else {
+        ChaCha20::random_key(key);
+    }
+    std::vector<uint8_t> header;
+    std::unique_ptr<OutputFile> container;
+    if(packed) {
+        header = SketchContainer::header(code, input_bytes, number_secure_sketch);
+        container.reset(new OutputFile(output_file_name));
+        if(!container->write_at(0, header.data(), header.size())) {
+            std::cerr << "Couldn't write file " << output_file_name << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    std::vector<std::vector<uint8_t>> buffers(slots, std::vector<uint8_t>(chunk_sketches * sketch_bytes));
+    std::vector<uint64_t> finished(chunks, 0);
+    std::mutex sketches_mutex;
+    std::condition_variable chunk_finished;
+    ThreadPool pool(number_threads);
+    uint64_t submitted = 0;
+    for(uint64_t chunk = 0; chunk < chunks; ++chunk) {
+        //Chunk - 1 has been written, so its slot, and every slot before it, can take a new chunk.
+        for(; submitted < chunks && submitted < chunk + slots; ++submitted) {
+            for(uint64_t part = 0; part < chunk_parts; ++part) {
+                pool.submit([&, submitted, part](uint32_t worker) {
+                    uint64_t first = submitted * chunk_sketches;
+                    uint64_t count = std::min<uint64_t>(chunk_sketches, number_secure_sketch - first);
+                    uint64_t first_block = part * part_blocks;
+                    uint64_t part_count = std::min<uint64_t>(part_blocks, blocks - first_block);
+                    uint64_t messages = chunk_parts > 1 ? part_count : count * blocks;
+                    //Each random message only uses the low message_bits bits of its bytes.
+                    std::vector<uint8_t> random_data(message_bytes * messages);
+                    ChaCha20(key, submitted * chunk_parts + part).fill(random_data.data(), random_data.size());
+                    for(std::size_t i = 0; i < messages && message_bits % 8; ++i) {
+                        random_data[i * message_bytes] &= (1 << (message_bits % 8)) - 1;
+                    }
+                    uint8_t* out = buffers[submitted % slots].data();
+                    if(chunk_parts > 1) {
+                        codes[worker].sketch(input, input_bytes, first_block, part_count, random_data.data(),
+                                             out + first_block * code.codeword_bytes());
+                    }
+                    else {
+                        codes[worker].sketches(input, input_bytes, count, random_data.data(), out);
+                    }
+                    std::lock_guard<std::mutex> lock(sketches_mutex);
+                    if(++finished[submitted] == chunk_parts) {
+                        chunk_finished.notify_one();
+                    }
+                });
+            }
+        }
+        {
+            std::unique_lock<std::mutex> lock(sketches_mutex);
+            chunk_finished.wait(lock, [&]() { return finished[chunk] == chunk_parts; });
+        }
+        const uint8_t* sketches = buffers[chunk % slots].data();
+        uint64_t first = chunk * chunk_sketches;
+        uint64_t count = std::min<uint64_t>(chunk_sketches, number_secure_sketch - first);
+        if(packed) {
+            if(!container->write_at(header.size() + first * sketch_bytes, sketches, count * sketch_bytes)) {
+                std::cerr << "Couldn't write file " << output_file_name << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else {
+            for(uint64_t i = 0; i < count; ++i) {
+                std::string output_name = output_file_name + std::to_string(first + i);
+                if(!write_file(output_name, sketches + i * sketch_bytes, sketch_bytes)) {
+                    std::cerr << "Couldn't write file " << output_name << std::endl;
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+    }
+    if(packed && !container->close()) {
+        std::cerr << "Couldn't write file " << output_file_name << std::endl;
+        return EXIT_FAILURE;
     }
     return EXIT_SUCCESS;
 }
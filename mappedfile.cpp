@@ -0,0 +1,180 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "mappedfile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <utility>
+
+MappedFile::MappedFile(): data_(nullptr), size_(0), open_(false) {
+}
+
+MappedFile::MappedFile(const std::string& path): MappedFile() {
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return;
+    }
+    struct stat info;
+    if(fstat(fd, &info)) {
+        close(fd);
+        return;
+    }
+    //Files of size 0 may still have contents, as procfs files do.
+    void* mapped = MAP_FAILED;
+    if(S_ISREG(info.st_mode) && info.st_size) {
+        mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    if(mapped != MAP_FAILED) {
+        size_ = info.st_size;
+        //The whole file is read front to back.
+        madvise(mapped, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const uint8_t*>(mapped);
+    }
+    else if(!read_(fd)) {
+        close(fd);
+        return;
+    }
+    //The mapping stays valid after the descriptor is closed.
+    close(fd);
+    open_ = true;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept: data_(other.data_), size_(other.size_), open_(other.open_),
+    buffer_(std::move(other.buffer_)) {
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.open_ = false;
+    other.buffer_.clear();
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if(this != &other) {
+        release_();
+        data_ = other.data_;
+        size_ = other.size_;
+        open_ = other.open_;
+        buffer_ = std::move(other.buffer_);
+        other.data_ = nullptr;
+        other.size_ = 0;
+        other.open_ = false;
+        other.buffer_.clear();
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile() {
+    release_();
+}
+
+const uint8_t* MappedFile::data() const {
+    return data_;
+}
+
+std::size_t MappedFile::size() const {
+    return size_;
+}
+
+MappedFile::operator bool() const {
+    return open_;
+}
+
+bool MappedFile::read_(int fd) {
+    std::size_t size = 0;
+    buffer_.resize(64 * 1024);
+    while(true) {
+        if(size == buffer_.size()) {
+            buffer_.resize(2 * size);
+        }
+        ssize_t got = read(fd, buffer_.data() + size, buffer_.size() - size);
+        if(got < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            buffer_.clear();
+            return false;
+        }
+        if(!got) {
+            break;
+        }
+        size += got;
+    }
+    buffer_.resize(size);
+    buffer_.shrink_to_fit();
+    size_ = size;
+    data_ = size ? buffer_.data() : nullptr;
+    return true;
+}
+
+void MappedFile::release_() {
+    if(data_ && buffer_.empty()) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    open_ = false;
+    buffer_.clear();
+}
+
+OutputFile::OutputFile(const std::string& path): fd_(open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)) {
+}
+
+OutputFile::~OutputFile() {
+    close();
+}
+
+bool OutputFile::write_at(uint64_t offset, const uint8_t* data, std::size_t size) {
+    if(fd_ < 0) {
+        return false;
+    }
+    //One call for the whole buffer unless the kernel writes less.
+    while(size) {
+        ssize_t written = pwrite(fd_, data, size, offset);
+        if(written < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+}
+
+bool OutputFile::close() {
+    if(fd_ < 0) {
+        return false;
+    }
+    int ret = ::close(fd_);
+    fd_ = -1;
+    return !ret;
+}
+
+OutputFile::operator bool() const {
+    return fd_ >= 0;
+}
+
+bool write_file(const std::string& path, const uint8_t* data, std::size_t size) {
+    OutputFile file(path);
+    return file.write_at(0, data, size) && file.close();
+}
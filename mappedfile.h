@@ -0,0 +1,97 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Read only view of a whole file mapped into memory. Check it with operator bool, like a stream, before use.
+ * Files that can't be mapped, like pipes, /dev/stdin or procfs files, are read into a buffer it owns instead.
+ */
+class MappedFile {
+public:
+    MappedFile();
+    
+    explicit MappedFile(const std::string& path);
+    
+    MappedFile(const MappedFile&) = delete;
+    
+    MappedFile(MappedFile&& other) noexcept;
+    
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    
+    ~MappedFile();
+    
+    //nullptr for an empty file.
+    const uint8_t* data() const;
+    
+    std::size_t size() const;
+    
+    explicit operator bool() const;
+    
+private:
+    const uint8_t* data_;
+    std::size_t size_;
+    bool open_;
+    //Holds the file when it isn't mapped.
+    std::vector<uint8_t> buffer_;
+    
+    //Reads fd to its end into buffer_. Returns false on failure.
+    bool read_(int fd);
+    
+    void release_();
+};
+
+/**
+ * File opened for writing at explicit offsets, so independent parts of it can be written in any order.
+ * The file is created or truncated when opened.
+ */
+class OutputFile {
+public:
+    explicit OutputFile(const std::string& path);
+    
+    OutputFile(const OutputFile&) = delete;
+    
+    OutputFile& operator=(const OutputFile&) = delete;
+    
+    ~OutputFile();
+    
+    //Returns false on failure.
+    bool write_at(uint64_t offset, const uint8_t* data, std::size_t size);
+    
+    //Returns false if closing reports an error, e.g. a failed delayed write.
+    bool close();
+    
+    explicit operator bool() const;
+    
+private:
+    int fd_;
+};
+
+//Creates or truncates path and writes size bytes to it. Returns false on failure.
+bool write_file(const std::string& path, const uint8_t* data, std::size_t size);
+
+#endif // MAPPEDFILE_H
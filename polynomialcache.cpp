@@ -0,0 +1,252 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "polynomialcache.h"
+#include "mappedfile.h"
+#include "scratcharena.h"
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+/*
+ * Cache file, integers little endian: "BCHCACHE", version (u32),
+ * minimal polynomial count (u32), then m (u8), coset leader (u16) and polynomial (u32) for each,
+ * code count (u32), then m (u8), t (u32), generator byte count (u32) and the generator, most significant byte first.
+ */
+static const char magic_[8] = {'B', 'C', 'H', 'C', 'A', 'C', 'H', 'E'};
+static const uint32_t version_ = 2;
+
+static void put_(std::vector<uint8_t>& out, uint64_t value, uint32_t bytes) {
+    for(uint32_t i = 0; i < bytes; ++i) {
+        out.push_back(uint8_t(value >> (8 * i)));
+    }
+}
+
+//Reads bytes bytes at *position, advancing it. Returns false past the end.
+static bool get_(const uint8_t* data, std::size_t size, std::size_t* position, uint32_t bytes, uint64_t* value) {
+    if(size - *position < bytes) {
+        return false;
+    }
+    *value = 0;
+    for(uint32_t i = 0; i < bytes; ++i) {
+        *value |= uint64_t(data[*position + i]) << (8 * i);
+    }
+    *position += bytes;
+    return true;
+}
+
+//p(alpha^exponent) by Horner's rule, degree being the degree of p.
+static uint16_t evaluate_(const GaloisField& field, const BitVector& polynomial, uint32_t degree, uint32_t exponent) {
+    const uint16_t* log = field.log_table();
+    const uint16_t* anti_log = field.anti_log_table();
+    uint16_t ret = 0;
+    for(uint32_t i = degree + 1; i-- > 0; ) {
+        ret = (ret ? anti_log[log[ret - 1] + exponent] : 0) ^ polynomial.test(i);
+    }
+    return ret;
+}
+
+//Cheap checks that catch corrupt or foreign entries without rebuilding them, which would cost as much as not
+//having a cache. A minimal polynomial is fully checked: alpha^leader is a root and its degree is the coset size.
+//A generator gets its degree bounded by m * t and is spot checked at alpha and alpha^(2t - 1).
+static bool valid_minimal_polynomial_(uint8_t m, uint16_t leader, uint32_t polynomial) {
+    const uint32_t order = (1u << m) - 1;
+    if(leader >= order || PolynomialCache::coset_leader(m, leader) != leader || !polynomial) {
+        return false;
+    }
+    uint32_t coset_size = 1;
+    for(uint32_t conjugate = (2 * leader) % order; conjugate != leader; conjugate = (2 * conjugate) % order) {
+        ++coset_size;
+    }
+    const BitVector minimal(polynomial);
+    const uint32_t degree = minimal.msb();
+    return degree == coset_size && !evaluate_(GaloisField(m), minimal, degree, leader);
+}
+
+static bool valid_generator_(uint8_t m, uint32_t t, const BitVector& generator) {
+    uint8_t zero = 0;
+    const uint32_t degree = generator.msb(&zero);
+    const uint32_t order = (1u << m) - 1;
+    if(zero || !t || degree > uint64_t(m) * t || !generator.test(0)) {
+        return false;
+    }
+    const GaloisField field(m);
+    return !evaluate_(field, generator, degree, 1) && !evaluate_(field, generator, degree, (2 * uint64_t(t) - 1) % order);
+}
+
+PolynomialCache::PolynomialCache(): modified_(false) {
+}
+
+PolynomialCache& PolynomialCache::instance() {
+    static PolynomialCache cache;
+    return cache;
+}
+
+uint16_t PolynomialCache::coset_leader(uint8_t m, uint32_t exponent) {
+    const uint32_t order = (1u << m) - 1;
+    exponent %= order;
+    uint32_t ret = exponent;
+    for(uint32_t i = 1, conjugate = exponent; i < m; ++i) {
+        conjugate = (2 * conjugate) % order;
+        if(conjugate < ret) {
+            ret = conjugate;
+        }
+    }
+    return ret;
+}
+
+uint32_t PolynomialCache::minimal_polynomial(const GaloisField& field, uint32_t exponent) {
+    std::pair<uint8_t, uint16_t> key(field.size(), coset_leader(field.size(), exponent));
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        std::map<std::pair<uint8_t, uint16_t>, uint32_t>::const_iterator found = minimal_polynomials_.find(key);
+        if(found != minimal_polynomials_.end()) {
+            return found->second;
+        }
+    }
+    uint32_t ret = field.minimal_polinomial(key.second);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    modified_ = minimal_polynomials_.insert(std::make_pair(key, ret)).second || modified_;
+    return ret;
+}
+
+std::shared_ptr<const PolynomialCache::code_polynomials> PolynomialCache::code(const GaloisField& field, uint32_t t) {
+    std::pair<uint8_t, uint32_t> key(field.size(), t);
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        std::map<std::pair<uint8_t, uint32_t>, std::shared_ptr<const code_polynomials>>::const_iterator found = codes_.find(key);
+        if(found != codes_.end()) {
+            return found->second;
+        }
+    }
+    //Cached polynomials outlive any scratch scope the caller may be in.
+    ScratchArena::Suspend heap;
+    //alpha^1 ... alpha^2t must be roots. Even exponents are in the coset of their odd part and odd exponents can
+    //share a coset too (3 and 9 modulo 15), so each coset's minimal polynomial is multiplied in once.
+    const uint32_t order = (1u << field.size()) - 1;
+    std::vector<bool> taken(order, false);
+    BitVector generator = 1;
+    for(uint32_t i = 0; i < t; ++i) {
+        uint16_t leader = coset_leader(field.size(), 1 + (i * 2));
+        if(taken[leader]) {
+            continue;
+        }
+        taken[leader] = true;
+        multiply(generator, BitVector(minimal_polynomial(field, leader)));
+    }
+    std::shared_ptr<const code_polynomials> ret(new code_polynomials{generator, RemainderTable(generator)});
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    std::pair<std::map<std::pair<uint8_t, uint32_t>, std::shared_ptr<const code_polynomials>>::iterator, bool> inserted =
+        codes_.insert(std::make_pair(key, ret));
+    modified_ = inserted.second || modified_;
+    return inserted.first->second;
+}
+
+bool PolynomialCache::load(const std::string& path) {
+    MappedFile file(path);
+    if(!file || file.size() < sizeof(magic_) || std::memcmp(file.data(), magic_, sizeof(magic_))) {
+        return false;
+    }
+    const uint8_t* data = file.data();
+    const std::size_t size = file.size();
+    std::size_t position = sizeof(magic_);
+    uint64_t version, count;
+    if(!get_(data, size, &position, 4, &version) || version != version_ || !get_(data, size, &position, 4, &count)) {
+        return false;
+    }
+    //Everything is parsed before anything is inserted, so a truncated file leaves the cache untouched.
+    std::vector<std::pair<std::pair<uint8_t, uint16_t>, uint32_t>> minimal_polynomials;
+    for(uint64_t i = 0; i < count; ++i) {
+        uint64_t m, leader, polynomial;
+        if(!get_(data, size, &position, 1, &m) || !get_(data, size, &position, 2, &leader) || !get_(data, size, &position, 4, &polynomial)
+           || m < 1 || m > 16 || !valid_minimal_polynomial_(m, leader, polynomial)) {
+            return false;
+        }
+        minimal_polynomials.push_back(std::make_pair(std::make_pair(uint8_t(m), uint16_t(leader)), uint32_t(polynomial)));
+    }
+    if(!get_(data, size, &position, 4, &count)) {
+        return false;
+    }
+    ScratchArena::Suspend heap;
+    std::vector<std::pair<std::pair<uint8_t, uint32_t>, std::shared_ptr<const code_polynomials>>> codes;
+    for(uint64_t i = 0; i < count; ++i) {
+        uint64_t m, t, bytes;
+        if(!get_(data, size, &position, 1, &m) || !get_(data, size, &position, 4, &t) || !get_(data, size, &position, 4, &bytes)
+           || m < 1 || m > 16 || !bytes || size - position < bytes) {
+            return false;
+        }
+        BitVector generator(data + position, data + position + bytes);
+        position += bytes;
+        if(!valid_generator_(m, t, generator)) {
+            return false;
+        }
+        codes.push_back(std::make_pair(std::make_pair(uint8_t(m), uint32_t(t)),
+                                       std::shared_ptr<const code_polynomials>(new code_polynomials{generator, RemainderTable(generator)})));
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    minimal_polynomials_.insert(minimal_polynomials.begin(), minimal_polynomials.end());
+    codes_.insert(codes.begin(), codes.end());
+    modified_ = false;
+    return true;
+}
+
+bool PolynomialCache::save(const std::string& path) const {
+    std::vector<uint8_t> out(magic_, magic_ + sizeof(magic_));
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        put_(out, version_, 4);
+        put_(out, minimal_polynomials_.size(), 4);
+        for(const std::pair<const std::pair<uint8_t, uint16_t>, uint32_t>& entry : minimal_polynomials_) {
+            put_(out, entry.first.first, 1);
+            put_(out, entry.first.second, 2);
+            put_(out, entry.second, 4);
+        }
+        put_(out, codes_.size(), 4);
+        for(const std::pair<const std::pair<uint8_t, uint32_t>, std::shared_ptr<const code_polynomials>>& entry : codes_) {
+            std::vector<uint8_t> generator(entry.second->generator.begin(), entry.second->generator.end());
+            put_(out, entry.first.first, 1);
+            put_(out, entry.first.second, 4);
+            put_(out, generator.size(), 4);
+            out.insert(out.end(), generator.begin(), generator.end());
+        }
+    }
+    //Written next to the target and renamed over it, so readers (or a mapping of the old file) never see a
+    //partial cache.
+    const std::string temporary = path + ".tmp";
+    if(!write_file(temporary, out.data(), out.size()) || std::rename(temporary.c_str(), path.c_str())) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    modified_ = false;
+    return true;
+}
+
+bool PolynomialCache::modified() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return modified_;
+}
+
+void PolynomialCache::clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    minimal_polynomials_.clear();
+    codes_.clear();
+    modified_ = false;
+}
@@ -0,0 +1,79 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef POLYNOMIALCACHE_H
+#define POLYNOMIALCACHE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include "bitvector.h"
+#include "galoisfield.h"
+
+/**
+ * Process wide cache of the polynomials BCH codes are built from: minimal polynomials keyed by field order and
+ * cyclotomic coset (so conjugate exponents share one entry) and generator polynomials, with their remainder
+ * tables, keyed by (m, t). Lookups take a shared lock; missing entries are computed outside of any lock and then
+ * inserted, so concurrent users never wait on each other's computations.
+ * The cache can be saved to and merged from a table file, so known codes need no computation at all.
+ */
+class PolynomialCache {
+public:
+    struct code_polynomials {
+        BitVector generator;
+        RemainderTable remainder_table;
+    };
+    
+    static PolynomialCache& instance();
+    
+    //Smallest exponent in the cyclotomic coset of exponent modulo 2^m - 1.
+    static uint16_t coset_leader(uint8_t m, uint32_t exponent);
+    
+    uint32_t minimal_polynomial(const GaloisField& field, uint32_t exponent);
+    
+    //Generator of the BCH code correcting t errors over field: the product of the distinct minimal polynomials of
+    //alpha^1, alpha^2, ..., alpha^2t, one per cyclotomic coset.
+    std::shared_ptr<const code_polynomials> code(const GaloisField& field, uint32_t t);
+    
+    //Merges the entries of a file written by save. Returns false, leaving the cache untouched, if it can't be read,
+    //isn't a cache file or any polynomial fails a quick check against its key.
+    bool load(const std::string& path);
+    
+    //Replaces path atomically.
+    bool save(const std::string& path) const;
+    
+    //Entries added since the cache was created or last loaded or saved.
+    bool modified() const;
+    
+    //Drops every entry, so the next codes are computed from scratch. Codes already built keep their polynomials.
+    void clear();
+    
+private:
+    PolynomialCache();
+    
+    mutable std::shared_mutex mutex_;
+    std::map<std::pair<uint8_t, uint16_t>, uint32_t> minimal_polynomials_;
+    std::map<std::pair<uint8_t, uint32_t>, std::shared_ptr<const code_polynomials>> codes_;
+    mutable bool modified_;
+};
+
+#endif // POLYNOMIALCACHE_H
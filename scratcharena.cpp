@@ -0,0 +1,90 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scratcharena.h"
+
+static thread_local ScratchArena* current_arena_ = nullptr;
+
+ScratchArena::ScratchArena(std::size_t block_size): block_size_(block_size), current_block_(0), offset_(0) {
+}
+
+ScratchArena::~ScratchArena() {
+    for(block_& block : blocks_) {
+        delete[] block.data;
+    }
+}
+
+void* ScratchArena::allocate(std::size_t bytes) {
+    const std::size_t alignment = alignof(std::max_align_t);
+    bytes = (bytes + alignment - 1) / alignment * alignment;
+    //Blocks left behind by a rewind are reused; ones too small for this request are skipped.
+    while(current_block_ < blocks_.size()) {
+        if(offset_ + bytes <= blocks_[current_block_].size) {
+            void* ret = blocks_[current_block_].data + offset_;
+            offset_ += bytes;
+            return ret;
+        }
+        ++current_block_;
+        offset_ = 0;
+    }
+    block_ block;
+    block.size = bytes > block_size_ ? bytes : block_size_;
+    block.data = new char[block.size];
+    blocks_.push_back(block);
+    current_block_ = blocks_.size() - 1;
+    offset_ = bytes;
+    return block.data;
+}
+
+std::size_t ScratchArena::used() const {
+    std::size_t ret = offset_;
+    for(std::size_t i = 0; i < current_block_ && i < blocks_.size(); ++i) {
+        ret += blocks_[i].size;
+    }
+    return ret;
+}
+
+ScratchArena* ScratchArena::current() {
+    return current_arena_;
+}
+
+ScratchArena& ScratchArena::thread_arena() {
+    static thread_local ScratchArena arena;
+    return arena;
+}
+
+ScratchArena::Scope::Scope(): Scope(ScratchArena::thread_arena()) {
+}
+
+ScratchArena::Scope::Scope(ScratchArena& arena): arena_(&arena), previous_(current_arena_), block_(arena.current_block_), offset_(arena.offset_) {
+    current_arena_ = arena_;
+}
+
+ScratchArena::Scope::~Scope() {
+    arena_->current_block_ = block_;
+    arena_->offset_ = offset_;
+    current_arena_ = previous_;
+}
+
+ScratchArena::Suspend::Suspend(): previous_(current_arena_) {
+    current_arena_ = nullptr;
+}
+
+ScratchArena::Suspend::~Suspend() {
+    current_arena_ = previous_;
+}
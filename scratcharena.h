@@ -0,0 +1,149 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCRATCHARENA_H
+#define SCRATCHARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Bump allocator for short lived temporaries. Memory is only given back when a Scope ends, by rewinding
+ * to where the arena was when the scope started, so nested scopes (an encode inside a batch) are fine.
+ * Each thread has its own arena; while a Scope is active on a thread, BitVector and ScratchBuffer take
+ * their memory from it instead of new[].
+ * Anything allocated inside a scope must not outlive it: use BitVector::detached() for results.
+ */
+class ScratchArena {
+public:
+    explicit ScratchArena(std::size_t block_size = 64 * 1024);
+    
+    ScratchArena(const ScratchArena&) = delete;
+    
+    ScratchArena& operator=(const ScratchArena&) = delete;
+    
+    ~ScratchArena();
+    
+    //Aligned to alignof(std::max_align_t).
+    void* allocate(std::size_t bytes);
+    
+    //Bytes handed out since the last rewind to the start.
+    std::size_t used() const;
+    
+    //The arena in use on this thread, or nullptr outside of any Scope.
+    static ScratchArena* current();
+    
+    //This thread's arena.
+    static ScratchArena& thread_arena();
+    
+    class Scope {
+    public:
+        Scope();
+        
+        explicit Scope(ScratchArena& arena);
+        
+        Scope(const Scope&) = delete;
+        
+        Scope& operator=(const Scope&) = delete;
+        
+        ~Scope();
+        
+    private:
+        ScratchArena* arena_;
+        ScratchArena* previous_;
+        std::size_t block_;
+        std::size_t offset_;
+    };
+    
+    //Turns the arena off for this thread while alive, so allocations go to the heap.
+    class Suspend {
+    public:
+        Suspend();
+        
+        Suspend(const Suspend&) = delete;
+        
+        Suspend& operator=(const Suspend&) = delete;
+        
+        ~Suspend();
+        
+    private:
+        ScratchArena* previous_;
+    };
+    
+private:
+    struct block_ {
+        char* data;
+        std::size_t size;
+    };
+    
+    std::vector<block_> blocks_;
+    std::size_t block_size_;
+    std::size_t current_block_;
+    std::size_t offset_;
+};
+
+/**
+ * Array of trivially copyable T taken from the current ScratchArena, or from the heap when there is none.
+ */
+template<typename T>
+class ScratchBuffer {
+public:
+    explicit ScratchBuffer(std::size_t count): arena_(ScratchArena::current()) {
+        if(arena_) {
+            data_ = static_cast<T*>(arena_->allocate(count * sizeof(T)));
+        }
+        else {
+            data_ = new T[count];
+        }
+    }
+    
+    ScratchBuffer(std::size_t count, const T& value): ScratchBuffer(count) {
+        for(std::size_t i = 0; i < count; ++i) {
+            data_[i] = value;
+        }
+    }
+    
+    ScratchBuffer(const ScratchBuffer&) = delete;
+    
+    ScratchBuffer& operator=(const ScratchBuffer&) = delete;
+    
+    ~ScratchBuffer() {
+        if(!arena_) {
+            delete[] data_;
+        }
+    }
+    
+    T* data() {
+        return data_;
+    }
+    
+    T& operator[](std::size_t index) {
+        return data_[index];
+    }
+    
+    const T& operator[](std::size_t index) const {
+        return data_[index];
+    }
+    
+private:
+    ScratchArena* arena_;
+    T* data_;
+};
+
+#endif // SCRATCHARENA_H
@@ -0,0 +1,181 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "sketchcontainer.h"
+#include <cstring>
+
+static const char magic_[8] = {'B', 'C', 'H', 'S', 'K', 'E', 'T', 'C'};
+static const std::size_t fixed_header_bytes_ = 68;
+
+static void put_(uint8_t* out, uint64_t value, uint32_t bytes) {
+    for(uint32_t i = 0; i < bytes; ++i) {
+        out[i] = uint8_t(value >> (8 * i));
+    }
+}
+
+static uint64_t get_(const uint8_t* in, uint32_t bytes) {
+    uint64_t ret = 0;
+    for(uint32_t i = 0; i < bytes; ++i) {
+        ret |= uint64_t(in[i]) << (8 * i);
+    }
+    return ret;
+}
+
+std::vector<uint8_t> SketchContainer::header(const BlockCode& code, uint64_t input_bytes, uint64_t count) {
+    const BitVector& generator = code.code().generator_polynomial();
+    std::vector<uint8_t> generator_bytes(generator.begin(), generator.end());
+    uint64_t index_offset = (fixed_header_bytes_ + generator_bytes.size() + 7) / 8 * 8;
+    uint64_t data_offset = index_offset + 8 * count;
+    uint64_t sketch_bytes = code.sketch_bytes(input_bytes);
+    std::vector<uint8_t> ret(data_offset, 0);
+    std::memcpy(ret.data(), magic_, sizeof(magic_));
+    put_(&ret[8], version, 4);
+    put_(&ret[12], code.code().field_order(), 1);
+    put_(&ret[14], code.code().code_length(), 2);
+    put_(&ret[16], code.code().num_errors(), 4);
+    put_(&ret[20], code.block_bytes(), 4);
+    put_(&ret[24], code.codeword_bytes(), 4);
+    put_(&ret[28], code.blocks(input_bytes), 4);
+    put_(&ret[32], input_bytes, 8);
+    put_(&ret[40], count, 8);
+    put_(&ret[48], index_offset, 8);
+    put_(&ret[56], data_offset, 8);
+    put_(&ret[64], generator_bytes.size(), 4);
+    std::memcpy(&ret[fixed_header_bytes_], generator_bytes.data(), generator_bytes.size());
+    for(uint64_t i = 0; i < count; ++i) {
+        put_(&ret[index_offset + 8 * i], data_offset + i * sketch_bytes, 8);
+    }
+    return ret;
+}
+
+SketchContainer::SketchContainer(): valid_(false), field_order_(0), code_length_(0), num_errors_(0), block_bytes_(0),
+    codeword_bytes_(0), blocks_(0), input_bytes_(0), size_(0), index_offset_(0), generator_bytes_(0) {
+}
+
+SketchContainer::SketchContainer(const std::string& path): SketchContainer() {
+    file_ = MappedFile(path);
+    valid_ = file_ && validate_();
+}
+
+SketchContainer::operator bool() const {
+    return valid_;
+}
+
+uint8_t SketchContainer::field_order() const {
+    return field_order_;
+}
+
+uint32_t SketchContainer::num_errors() const {
+    return num_errors_;
+}
+
+uint32_t SketchContainer::code_length() const {
+    return code_length_;
+}
+
+uint32_t SketchContainer::block_bytes() const {
+    return block_bytes_;
+}
+
+uint32_t SketchContainer::codeword_bytes() const {
+    return codeword_bytes_;
+}
+
+uint32_t SketchContainer::blocks() const {
+    return blocks_;
+}
+
+uint64_t SketchContainer::input_bytes() const {
+    return input_bytes_;
+}
+
+uint64_t SketchContainer::size() const {
+    return size_;
+}
+
+BitVector SketchContainer::generator_polynomial() const {
+    const uint8_t* generator = file_.data() + fixed_header_bytes_;
+    return BitVector(generator, generator + generator_bytes_);
+}
+
+BlockCode SketchContainer::code() const {
+    return BlockCode(BCH(GaloisField(field_order_), num_errors_, code_length_), block_bytes_);
+}
+
+std::size_t SketchContainer::sketch_bytes() const {
+    return std::size_t(blocks_) * codeword_bytes_;
+}
+
+const uint8_t* SketchContainer::sketch(uint64_t index) const {
+    if(index >= size_) {
+        return nullptr;
+    }
+    return file_.data() + get_(file_.data() + index_offset_ + 8 * index, 8);
+}
+
+bool SketchContainer::validate_() {
+    const uint8_t* data = file_.data();
+    const uint64_t file_size = file_.size();
+    if(file_size < fixed_header_bytes_ || std::memcmp(data, magic_, sizeof(magic_)) || get_(data + 8, 4) != version) {
+        return false;
+    }
+    field_order_ = get_(data + 12, 1);
+    code_length_ = get_(data + 14, 2);
+    num_errors_ = get_(data + 16, 4);
+    block_bytes_ = get_(data + 20, 4);
+    codeword_bytes_ = get_(data + 24, 4);
+    blocks_ = get_(data + 28, 4);
+    input_bytes_ = get_(data + 32, 8);
+    size_ = get_(data + 40, 8);
+    index_offset_ = get_(data + 48, 8);
+    generator_bytes_ = get_(data + 64, 4);
+    //A code has at least 2t parity bits, which also keeps t from making the code below expensive to build.
+    if(field_order_ < 4 || field_order_ > 16 || code_length_ > (1u << field_order_) - 1 || !num_errors_
+       || num_errors_ > code_length_ / 2 || !block_bytes_
+       || block_bytes_ > code_length_ / 8 || codeword_bytes_ != (code_length_ + 7) / 8 || blocks_ != (input_bytes_ + block_bytes_ - 1) / block_bytes_) {
+        return false;
+    }
+    if(fixed_header_bytes_ + generator_bytes_ > file_size || index_offset_ < fixed_header_bytes_ + generator_bytes_
+       || index_offset_ > file_size || size_ > (file_size - index_offset_) / 8) {
+        return false;
+    }
+    //The sketches are only usable with the code they were made with, so the stored generator has to be the one
+    //code() builds.
+    const BCH rebuilt(GaloisField(field_order_), num_errors_, code_length_);
+    const BitVector& generator = rebuilt.generator_polynomial();
+    std::vector<uint8_t> generator_bytes(generator.begin(), generator.end());
+    if(!rebuilt || generator_bytes.size() != generator_bytes_
+       || std::memcmp(generator_bytes.data(), data + fixed_header_bytes_, generator_bytes_)) {
+        return false;
+    }
+    //The data starts right after the index and every sketch has to lie between it and the end of the file, so
+    //sketch() only has to check the index.
+    const uint64_t data_offset = get_(data + 56, 8);
+    if(data_offset != index_offset_ + 8 * size_) {
+        return false;
+    }
+    const uint64_t bytes = sketch_bytes();
+    for(uint64_t i = 0; i < size_; ++i) {
+        uint64_t offset = get_(data + index_offset_ + 8 * i, 8);
+        if(offset < data_offset || offset > file_size || bytes > file_size - offset) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,100 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SKETCHCONTAINER_H
+#define SKETCHCONTAINER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "bitvector.h"
+#include "blockcode.h"
+#include "mappedfile.h"
+
+/**
+ * Single file holding many secure sketches of the same input made with the same BlockCode.
+ * Layout, integers little endian:
+ *   0  "BCHSKETC"           8  version (u32)       12 field order m (u8), 1 reserved byte, 14 code length (u16)
+ *   16 errors t (u32)       20 block bytes (u32)   24 codeword bytes (u32)   28 blocks (u32)
+ *   32 input bytes (u64)    40 sketch count (u64)  48 index offset (u64)     56 data offset (u64)
+ *   64 generator bytes (u32), then the generator polynomial, most significant byte first,
+ *   padding to a multiple of 8, the index (one u64 file offset per sketch) and, from the data offset right after
+ *   the index, the packed sketches. Every index entry points at or past the data offset.
+ * Opening a container maps it and validates the layout; sketches are then read in place.
+ */
+class SketchContainer {
+public:
+    static const uint32_t version = 2;
+    
+    //Header and index of a container of count sketches of input_bytes bytes of input. Sketch i starts at
+    //header.size() + i * code.sketch_bytes(input_bytes).
+    static std::vector<uint8_t> header(const BlockCode& code, uint64_t input_bytes, uint64_t count);
+    
+    SketchContainer();
+    
+    explicit SketchContainer(const std::string& path);
+    
+    //False if the file couldn't be mapped or isn't a valid container.
+    explicit operator bool() const;
+    
+    uint8_t field_order() const;
+    
+    uint32_t num_errors() const;
+    
+    uint32_t code_length() const;
+    
+    uint32_t block_bytes() const;
+    
+    uint32_t codeword_bytes() const;
+    
+    uint32_t blocks() const;
+    
+    uint64_t input_bytes() const;
+    
+    uint64_t size() const;
+    
+    BitVector generator_polynomial() const;
+    
+    //The code the sketches were made with.
+    BlockCode code() const;
+    
+    std::size_t sketch_bytes() const;
+    
+    //Null if index isn't below size().
+    const uint8_t* sketch(uint64_t index) const;
+    
+private:
+    MappedFile file_;
+    bool valid_;
+    uint8_t field_order_;
+    uint32_t code_length_;
+    uint32_t num_errors_;
+    uint32_t block_bytes_;
+    uint32_t codeword_bytes_;
+    uint32_t blocks_;
+    uint64_t input_bytes_;
+    uint64_t size_;
+    uint64_t index_offset_;
+    uint32_t generator_bytes_;
+    
+    bool validate_();
+};
+
+#endif // SKETCHCONTAINER_H
@@ -0,0 +1,289 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef STATICBITVECTOR_H
+#define STATICBITVECTOR_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "bitvector.h"
+#include "clmul.h"
+
+/**
+ * Polynomial over GF(2) of at most N bits, for codes whose length is known at compile time.
+ * Same layout as BitVector, bit i being the coefficient of x^i in 64 bit words, least significant word first,
+ * but kept in a std::array, so every loop runs over a constant number of words and only multiply, through
+ * clmul_words, may allocate: its Karatsuba scratch, for operands of at least karatsuba_threshold() words.
+ * Bits shifted past N are dropped instead of growing the vector. Bit indices must be below N.
+ * BCH doesn't use it yet; it is only exercised by the bench target.
+ */
+template<uint32_t N>
+class StaticBitVector {
+    static_assert(N > 0, "A StaticBitVector needs at least one bit.");
+public:
+    static constexpr uint32_t bits = N;
+    
+    static constexpr uint32_t words = (N + 63) / 64;
+    
+    constexpr StaticBitVector(): words_() {}
+    
+    constexpr explicit StaticBitVector(uint64_t value): words_() {
+        words_[0] = value;
+        clear_top_();
+    }
+    
+    //Bits of value from N up are dropped.
+    explicit StaticBitVector(const BitVector& value): words_() {
+        uint32_t bytes = value.end() - value.begin();
+        uint32_t index = bytes;
+        for(BitVector::const_iterator cur = value.begin(); cur != value.end(); ++cur) {
+            --index;
+            if(index / 8 < words) {
+                words_[index / 8] |= static_cast<uint64_t>(*cur) << ((index % 8) * 8);
+            }
+        }
+        clear_top_();
+    }
+    
+    BitVector to_bit_vector() const {
+        std::vector<uint8_t> bytes(words * 8);
+        for(uint32_t i = 0; i < words * 8; ++i) {
+            bytes[words * 8 - 1 - i] = words_[i / 8] >> ((i % 8) * 8);
+        }
+        return BitVector(bytes.begin(), bytes.end());
+    }
+    
+    constexpr bool test(uint32_t position) const {
+        return (words_[position / 64] >> (position % 64)) & 1;
+    }
+    
+    constexpr void set(uint32_t position, bool value = true) {
+        uint64_t mask = static_cast<uint64_t>(1) << (position % 64);
+        words_[position / 64] = (words_[position / 64] & ~mask) | (-static_cast<uint64_t>(value) & mask);
+    }
+    
+    constexpr void flip(uint32_t position) {
+        words_[position / 64] ^= static_cast<uint64_t>(1) << (position % 64);
+    }
+    
+    constexpr uint64_t word(uint32_t index) const {
+        return words_[index];
+    }
+    
+    constexpr uint64_t* data() {
+        return words_.data();
+    }
+    
+    constexpr const uint64_t* data() const {
+        return words_.data();
+    }
+    
+    constexpr StaticBitVector& operator^=(const StaticBitVector& other) {
+        for(uint32_t i = 0; i < words; ++i) {
+            words_[i] ^= other.words_[i];
+        }
+        return *this;
+    }
+    
+    constexpr StaticBitVector& operator&=(const StaticBitVector& other) {
+        for(uint32_t i = 0; i < words; ++i) {
+            words_[i] &= other.words_[i];
+        }
+        return *this;
+    }
+    
+    constexpr StaticBitVector& operator|=(const StaticBitVector& other) {
+        for(uint32_t i = 0; i < words; ++i) {
+            words_[i] |= other.words_[i];
+        }
+        return *this;
+    }
+    
+    constexpr StaticBitVector& operator<<=(uint32_t value) {
+        uint32_t word_shift = value / 64;
+        uint32_t bit_shift = value % 64;
+        for(uint32_t i = words; i > 0; --i) {
+            uint32_t dest = i - 1;
+            uint64_t word = 0;
+            if(dest >= word_shift) {
+                word = words_[dest - word_shift] << bit_shift;
+                if(bit_shift && dest > word_shift) {
+                    word |= words_[dest - word_shift - 1] >> (64 - bit_shift);
+                }
+            }
+            words_[dest] = word;
+        }
+        clear_top_();
+        return *this;
+    }
+    
+    constexpr StaticBitVector& operator>>=(uint32_t value) {
+        uint32_t word_shift = value / 64;
+        uint32_t bit_shift = value % 64;
+        for(uint32_t i = 0; i < words; ++i) {
+            uint32_t src = i + word_shift;
+            uint64_t word = src < words ? words_[src] >> bit_shift : 0;
+            if(bit_shift && src + 1 < words) {
+                word |= words_[src + 1] << (64 - bit_shift);
+            }
+            words_[i] = word;
+        }
+        return *this;
+    }
+    
+    constexpr StaticBitVector operator^(const StaticBitVector& other) const {
+        StaticBitVector tmp(*this);
+        tmp ^= other;
+        return tmp;
+    }
+    
+    constexpr StaticBitVector operator&(const StaticBitVector& other) const {
+        StaticBitVector tmp(*this);
+        tmp &= other;
+        return tmp;
+    }
+    
+    constexpr StaticBitVector operator|(const StaticBitVector& other) const {
+        StaticBitVector tmp(*this);
+        tmp |= other;
+        return tmp;
+    }
+    
+    constexpr StaticBitVector operator<<(uint32_t value) const {
+        StaticBitVector tmp(*this);
+        tmp <<= value;
+        return tmp;
+    }
+    
+    constexpr StaticBitVector operator>>(uint32_t value) const {
+        StaticBitVector tmp(*this);
+        tmp >>= value;
+        return tmp;
+    }
+    
+    constexpr bool operator==(const StaticBitVector& other) const {
+        return words_ == other.words_;
+    }
+    
+    constexpr bool operator!=(const StaticBitVector& other) const {
+        return words_ != other.words_;
+    }
+    
+    constexpr explicit operator bool() const {
+        uint64_t any = 0;
+        for(uint32_t i = 0; i < words; ++i) {
+            any |= words_[i];
+        }
+        return any;
+    }
+    
+    //Same as BitVector::msb: err is set to 1 and 0 returned if no bit is set.
+    constexpr uint32_t msb(uint8_t* err = nullptr) const {
+        for(uint32_t i = words; i > 0; --i) {
+            if(words_[i - 1]) {
+                if(err) {
+                    *err = 0;
+                }
+                return (i - 1) * 64 + 63 - __builtin_clzll(words_[i - 1]);
+            }
+        }
+        if(err) {
+            *err = 1;
+        }
+        return 0;
+    }
+    
+    constexpr uint32_t weight() const {
+        uint32_t ret = 0;
+        for(uint32_t i = 0; i < words; ++i) {
+            ret += __builtin_popcountll(words_[i]);
+        }
+        return ret;
+    }
+    
+    constexpr uint32_t size() const {
+        return N;
+    }
+    
+private:
+    constexpr void clear_top_() {
+        if(N % 64) {
+            words_[words - 1] &= (static_cast<uint64_t>(1) << (N % 64)) - 1;
+        }
+    }
+    
+    std::array<uint64_t, words> words_;
+};
+
+//The product of an L bit and an R bit polynomial always fits L + R - 1 bits.
+//The product is built on the stack, but clmul_words takes its Karatsuba scratch from the heap or the scratch arena.
+template<uint32_t L, uint32_t R>
+StaticBitVector<L + R - 1> multiply(const StaticBitVector<L>& left, const StaticBitVector<R>& right) {
+    uint64_t product[StaticBitVector<L>::words + StaticBitVector<R>::words];
+    clmul_words(left.data(), StaticBitVector<L>::words, right.data(), StaticBitVector<R>::words, product);
+    StaticBitVector<L + R - 1> ret;
+    for(uint32_t i = 0; i < StaticBitVector<L + R - 1>::words; ++i) {
+        ret.data()[i] = product[i];
+    }
+    return ret;
+}
+
+template<uint32_t L, uint32_t R>
+struct static_division_result {
+    StaticBitVector<L> q;
+    StaticBitVector<L> r;
+};
+
+//Same results as long_division on BitVector: a zero divisor leaves q = 0 and r = left.
+template<uint32_t L, uint32_t R>
+static_division_result<L, R> long_division(const StaticBitVector<L>& left, const StaticBitVector<R>& right) {
+    static_division_result<L, R> ret;
+    ret.r = left;
+    uint8_t divisor_zero = 0, dividend_zero = 0;
+    uint32_t divisor_degree = right.msb(&divisor_zero);
+    uint32_t dividend_degree = left.msb(&dividend_zero);
+    if(divisor_zero || dividend_zero || dividend_degree < divisor_degree) {
+        return ret;
+    }
+    uint64_t* remainder = ret.r.data();
+    const uint64_t* divisor = right.data();
+    for(uint32_t bit = dividend_degree + 1; bit-- > divisor_degree; ) {
+        if(!((remainder[bit / 64] >> (bit % 64)) & 1)) {
+            continue;
+        }
+        uint32_t offset = bit - divisor_degree;
+        uint32_t word_shift = offset / 64;
+        uint32_t bit_shift = offset % 64;
+        //The shifted divisor never reaches past bit, so words beyond L are all zero.
+        uint64_t carry = 0;
+        uint32_t i = 0;
+        for(; i < StaticBitVector<R>::words && i + word_shift < StaticBitVector<L>::words; ++i) {
+            remainder[i + word_shift] ^= bit_shift ? (divisor[i] << bit_shift) | carry : divisor[i];
+            carry = bit_shift ? divisor[i] >> (64 - bit_shift) : 0;
+        }
+        if(carry && i + word_shift < StaticBitVector<L>::words) {
+            remainder[i + word_shift] ^= carry;
+        }
+        ret.q.flip(offset);
+    }
+    return ret;
+}
+
+#endif // STATICBITVECTOR_H
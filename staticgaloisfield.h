@@ -0,0 +1,165 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STATICGALOISFIELD_H
+#define STATICGALOISFIELD_H
+
+#include <cstdint>
+
+//Primitive polynomials without their x^m term, indexed by m - 1.
+constexpr uint16_t primitive_polynomials[16] = {
+    0x0001, //x + 1
+    0x0003, //x^2 + x + 1
+    0x0003, //x^3 + x + 1
+    0x0003, //x^4 + x + 1
+    0x0005, //x^5 + x^2 + 1
+    0x0003, //x^6 + x + 1
+    0x0003, //x^7 + x + 1
+    0x001D, //x^8 + x^4 + x^3 + x^2 + 1
+    0x0011, //x^9 + x^4 + 1
+    0x0009, //x^10 + x^3 + 1
+    0x0005, //x^11 + x^2 + 1
+    0x0053, //x^12 + x^6 + x^4 + x + 1
+    0x001B, //x^13 + x^4 + x^3 + x + 1
+    0x0443, //x^14 + x^10 + x^6 + x + 1
+    0x0003, //x^15 + x + 1
+    0x100B  //x^16 + x^12 + x^3 + x + 1
+};
+
+/**
+ * Log and anti log tables of GF(2^M), built at compile time.
+ * log[v] is the discrete logarithm of v != 0. anti_log[i] = alpha^i is stored twice over,
+ * so the sum of two logarithms indexes it without a modulo.
+ */
+template<uint8_t M>
+struct galois_field_tables {
+    static constexpr uint32_t order = (1u << M) - 1;
+    
+    constexpr galois_field_tables() {
+        uint32_t current = 1;
+        for(uint32_t i = 0; i < order; ++i) {
+            anti_log[i] = current;
+            anti_log[i + order] = current;
+            log[current] = i;
+            current <<= 1;
+            if(current >> M) {
+                current ^= (1u << M) | primitive_polynomials[M - 1];
+            }
+        }
+    }
+    
+    uint16_t log[order + 1] = {};
+    
+    uint16_t anti_log[2 * order] = {};
+};
+
+/**
+ * Element of GF(2^M) for a field size known at compile time.
+ * Arithmetic is a couple of lookups into constexpr tables, so it needs no setup and folds for constant operands.
+ * Division by zero yields zero.
+ */
+template<uint8_t M>
+class StaticGaloisField {
+    static_assert(M >= 1 && M <= 16, "Only GF(2^1) to GF(2^16) are supported.");
+public:
+    static constexpr uint32_t order = galois_field_tables<M>::order;
+    
+    static constexpr galois_field_tables<M> tables = galois_field_tables<M>();
+    
+    constexpr StaticGaloisField(): number_(0) {}
+    
+    constexpr explicit StaticGaloisField(uint16_t number): number_(number & order) {}
+    
+    static constexpr uint16_t multiply(uint16_t left, uint16_t right) {
+        return left && right ? tables.anti_log[tables.log[left] + tables.log[right]] : 0;
+    }
+    
+    static constexpr uint16_t divide(uint16_t left, uint16_t right) {
+        return left && right ? tables.anti_log[tables.log[left] + order - tables.log[right]] : 0;
+    }
+    
+    static constexpr uint16_t inverse(uint16_t number) {
+        return number ? tables.anti_log[order - tables.log[number]] : 0;
+    }
+    
+    //alpha^exponent.
+    static constexpr uint16_t power(uint32_t exponent) {
+        return tables.anti_log[exponent % order];
+    }
+    
+    constexpr StaticGaloisField& operator+=(const StaticGaloisField& rhs) {
+        number_ ^= rhs.number_;
+        return *this;
+    }
+    
+    constexpr StaticGaloisField& operator-=(const StaticGaloisField& rhs) {
+        number_ ^= rhs.number_;
+        return *this;
+    }
+    
+    constexpr StaticGaloisField& operator*=(const StaticGaloisField& rhs) {
+        number_ = multiply(number_, rhs.number_);
+        return *this;
+    }
+    
+    constexpr StaticGaloisField& operator/=(const StaticGaloisField& rhs) {
+        number_ = divide(number_, rhs.number_);
+        return *this;
+    }
+    
+    constexpr StaticGaloisField operator+(const StaticGaloisField& rhs) const {
+        return StaticGaloisField(number_ ^ rhs.number_);
+    }
+    
+    constexpr StaticGaloisField operator-(const StaticGaloisField& rhs) const {
+        return StaticGaloisField(number_ ^ rhs.number_);
+    }
+    
+    constexpr StaticGaloisField operator*(const StaticGaloisField& rhs) const {
+        return StaticGaloisField(multiply(number_, rhs.number_));
+    }
+    
+    constexpr StaticGaloisField operator/(const StaticGaloisField& rhs) const {
+        return StaticGaloisField(divide(number_, rhs.number_));
+    }
+    
+    constexpr bool operator==(const StaticGaloisField& rhs) const {
+        return number_ == rhs.number_;
+    }
+    
+    constexpr bool operator!=(const StaticGaloisField& rhs) const {
+        return number_ != rhs.number_;
+    }
+    
+    constexpr StaticGaloisField inverse() const {
+        return StaticGaloisField(inverse(number_));
+    }
+    
+    constexpr StaticGaloisField pow(uint32_t exponent) const {
+        return number_ ? StaticGaloisField(power(static_cast<uint32_t>((static_cast<uint64_t>(tables.log[number_]) * exponent) % order))) : StaticGaloisField(exponent ? 0 : 1);
+    }
+    
+    constexpr explicit operator uint16_t() const {
+        return number_;
+    }
+    
+private:
+    uint16_t number_;
+};
+
+#endif // STATICGALOISFIELD_H
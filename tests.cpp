@@ -0,0 +1,562 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "bitvector.h"
+#include "staticbitvector.h"
+#include "galoisfield.h"
+#include "staticgaloisfield.h"
+#include "bch.h"
+#include "clmul.h"
+#include "gfbulk.h"
+#include "blockcode.h"
+#include "chacha20.h"
+#include "mappedfile.h"
+#include "polynomialcache.h"
+#include "sketchcontainer.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifndef EXIT_FAILURE
+#define EXIT_FAILURE 1
+#endif
+
+#ifndef EXIT_SUCCESS
+#define EXIT_SUCCESS 0
+#endif
+
+/**
+ * Correctness checks run by ctest, one test per argument. Each prints what went wrong and fails on the first
+ * mismatch. Random data comes from fixed seeds, so failures reproduce.
+ */
+
+#define CHECK(condition, what) \
+    do { \
+        if(!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " << what << std::endl; \
+            return false; \
+        } \
+    } while(0)
+
+//Codes covering full and shortened lengths, small and large t, over most field sizes.
+struct code_parameters {
+    uint8_t m;
+    uint32_t t;
+    uint32_t length;
+};
+
+static const code_parameters codes_[] = {
+    {4, 1, 0}, {4, 2, 0}, {5, 3, 0}, {6, 4, 40}, {7, 5, 0}, {8, 1, 0}, {8, 10, 0}, {8, 24, 200},
+    {9, 12, 0}, {10, 20, 800}, {11, 8, 0}, {12, 30, 0}, {13, 4, 1000}, {16, 3, 2000}
+};
+
+static std::vector<uint8_t> random_messages(const BCH& code, std::mt19937& random, std::size_t count) {
+    uint32_t bits = code.message_length();
+    uint32_t bytes = (bits + 7) / 8;
+    std::vector<uint8_t> ret(bytes * count);
+    for(uint8_t& byte : ret) {
+        byte = random();
+    }
+    for(std::size_t i = 0; i < count && bits % 8; ++i) {
+        ret[i * bytes] &= (1 << (bits % 8)) - 1;
+    }
+    return ret;
+}
+
+//Flips errors distinct bits below code_length() in a codeword of (code_length() + 7) / 8 bytes.
+static void add_errors(const BCH& code, std::mt19937& random, uint32_t errors, uint8_t* codeword) {
+    uint32_t bytes = (code.code_length() + 7) / 8;
+    std::vector<uint32_t> positions;
+    while(positions.size() < errors) {
+        uint32_t position = random() % code.code_length();
+        if(std::find(positions.begin(), positions.end(), position) == positions.end()) {
+            positions.push_back(position);
+            codeword[bytes - 1 - position / 8] ^= 1 << (position % 8);
+        }
+    }
+}
+
+//Codeword bytes laid out as in encode_batch.
+static std::vector<uint8_t> to_bytes(const BitVector& vector, uint32_t bytes) {
+    std::vector<uint8_t> ret(bytes, 0);
+    std::vector<uint8_t> exported(vector.begin(), vector.end());
+    for(std::size_t i = 0; i < exported.size() && i < bytes; ++i) {
+        ret[bytes - 1 - i] = exported[exported.size() - 1 - i];
+    }
+    return ret;
+}
+
+//Product of left and right one bit at a time.
+static std::vector<uint64_t> reference_product(const std::vector<uint64_t>& left, const std::vector<uint64_t>& right) {
+    std::vector<uint64_t> ret(left.size() + right.size(), 0);
+    for(std::size_t i = 0; i < 64 * left.size(); ++i) {
+        if(!((left[i / 64] >> (i % 64)) & 1)) {
+            continue;
+        }
+        for(std::size_t j = 0; j < right.size(); ++j) {
+            std::size_t word = i / 64 + j, shift = i % 64;
+            ret[word] ^= right[j] << shift;
+            if(shift) {
+                ret[word + 1] ^= right[j] >> (64 - shift);
+            }
+        }
+    }
+    return ret;
+}
+
+//clmul_words matches a bit at a time product with every kernel the CPU has, both with Karatsuba at every level
+//(threshold 2) and with the default threshold. Generators built with Karatsuba match the ones built without.
+static bool test_clmul() {
+    std::mt19937_64 random(6);
+    const uint32_t threshold = karatsuba_threshold();
+    const BitVector generator = BCH(GaloisField(10), 40).generator_polynomial();
+    //Kernels go from slowest to fastest, so the one picked at startup is left in place.
+    for(clmul_kernel kernel : {clmul_kernel::portable, clmul_kernel::pclmul}) {
+        if(!set_clmul_kernel(kernel)) {
+            continue;
+        }
+        for(uint32_t karatsuba : {2u, 3u, threshold}) {
+            set_karatsuba_threshold(karatsuba);
+            for(uint32_t i = 0; i < 40; ++i) {
+                std::vector<uint64_t> left(random() % 40 + 1), right(random() % 40 + 1);
+                for(uint64_t& word : left) {
+                    word = random();
+                }
+                for(uint64_t& word : right) {
+                    word = random();
+                }
+                std::vector<uint64_t> product(left.size() + right.size());
+                clmul_words(left.data(), left.size(), right.data(), right.size(), product.data());
+                CHECK(product == reference_product(left, right), "kernel " << int(kernel) << " threshold " << karatsuba
+                      << " product of " << left.size() << " by " << right.size() << " words differs");
+            }
+            PolynomialCache::instance().clear();
+            CHECK(BCH(GaloisField(10), 40).generator_polynomial() == generator,
+                  "kernel " << int(kernel) << " threshold " << karatsuba << " generator differs");
+        }
+    }
+    set_karatsuba_threshold(threshold);
+    return true;
+}
+
+//Every region kernel the CPU has matches log table products, for counts with and without a scalar tail.
+static bool test_gf_bulk() {
+    std::mt19937 random(7);
+    for(gf_region_kernel kernel : {gf_region_kernel::scalar, gf_region_kernel::ssse3, gf_region_kernel::avx2}) {
+        if(!set_gf_region_kernel(kernel)) {
+            continue;
+        }
+        for(uint8_t m : {4, 8, 13, 16}) {
+            GaloisField field(m);
+            for(std::size_t count : {16u, 100u, 1000u}) {
+                std::vector<uint16_t> src(count), product(count), accumulated(count);
+                for(std::size_t i = 0; i < count; ++i) {
+                    src[i] = random() & ((1u << m) - 1);
+                    accumulated[i] = random() & ((1u << m) - 1);
+                }
+                std::vector<uint16_t> expected = accumulated;
+                const uint16_t constant = random() % ((1u << m) - 1) + 1;
+                gf_multiply_region(field, constant, src.data(), product.data(), count);
+                gf_multiply_accumulate_region(field, constant, src.data(), accumulated.data(), count);
+                for(std::size_t i = 0; i < count; ++i) {
+                    uint16_t value = uint16_t(GaloisField(m, constant) * GaloisField(m, src[i]));
+                    expected[i] ^= value;
+                    CHECK(product[i] == value && accumulated[i] == expected[i],
+                          "kernel " << int(kernel) << " m=" << int(m) << " count " << count << " differs at " << i);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+template<uint8_t M>
+static bool check_static_field(std::mt19937& random) {
+    typedef StaticGaloisField<M> field;
+    for(uint32_t i = 0; i < 2000; ++i) {
+        uint16_t left = random() & field::order, right = random() & field::order;
+        uint32_t exponent = random();
+        GaloisField dynamic_left(M, left), dynamic_right(M, right);
+        CHECK(field::multiply(left, right) == uint16_t(dynamic_left * dynamic_right)
+              && (!right || field::divide(left, right) == uint16_t(dynamic_left / dynamic_right))
+              && (!left || field::inverse(left) == uint16_t(dynamic_left.inverse()))
+              && field::power(exponent) == uint16_t(GaloisField(M, 2).pow(exponent % field::order)),
+              "StaticGaloisField<" << int(M) << "> differs on " << left << ", " << right << ", " << exponent);
+    }
+    return true;
+}
+
+template<uint32_t L, uint32_t R>
+static bool check_static_vectors(std::mt19937& random) {
+    for(uint32_t i = 0; i < 50; ++i) {
+        StaticBitVector<L> left;
+        StaticBitVector<R> right;
+        for(uint32_t bit = 0; bit < L; ++bit) {
+            left.set(bit, random() & 1);
+        }
+        //Sparse divisors now and then, so quotients get long.
+        for(uint32_t bit = 0; bit < R; ++bit) {
+            right.set(bit, random() % (i % 2 ? 2 : 16) == 0);
+        }
+        const BitVector dynamic_left = left.to_bit_vector(), dynamic_right = right.to_bit_vector();
+        CHECK(multiply(left, right) == StaticBitVector<L + R - 1>(multiply(dynamic_left, dynamic_right)),
+              "StaticBitVector<" << L << "> * StaticBitVector<" << R << "> differs");
+        static_division_result<L, R> result = long_division(left, right);
+        division_result expected = long_division(dynamic_left, dynamic_right);
+        CHECK(result.q == StaticBitVector<L>(expected.q) && result.r == StaticBitVector<L>(expected.r),
+              "StaticBitVector<" << L << "> / StaticBitVector<" << R << "> differs");
+    }
+    return true;
+}
+
+//StaticGaloisField and StaticBitVector give the same results as GaloisField and BitVector.
+static bool test_static() {
+    std::mt19937 random(8);
+    return check_static_field<4>(random) && check_static_field<8>(random) && check_static_field<13>(random)
+           && check_static_field<16>(random) && check_static_vectors<64, 64>(random)
+           && check_static_vectors<255, 65>(random) && check_static_vectors<1100, 1100>(random)
+           && check_static_vectors<100, 200>(random);
+}
+
+//Every codeword with up to t errors decodes back to itself.
+static bool test_round_trip() {
+    std::mt19937 random(1);
+    for(const code_parameters& parameters : codes_) {
+        BCH code(GaloisField(parameters.m), parameters.t, parameters.length);
+        CHECK(code.message_length() > 0, "m=" << int(parameters.m) << " t=" << parameters.t << " has no message bits");
+        const uint32_t message_bytes = (code.message_length() + 7) / 8;
+        const uint32_t codeword_bytes = (code.code_length() + 7) / 8;
+        std::vector<uint8_t> messages = random_messages(code, random, 20);
+        for(uint32_t i = 0; i < 20; ++i) {
+            BitVector message(messages.begin() + i * message_bytes, messages.begin() + (i + 1) * message_bytes);
+            std::vector<uint8_t> codeword = to_bytes(code.encode(message), codeword_bytes);
+            std::vector<uint8_t> received = codeword;
+            add_errors(code, random, i % (parameters.t + 1), received.data());
+            uint8_t err = 0;
+            BitVector decoded = code.decode(BitVector(received.begin(), received.end()), &err);
+            CHECK(!err && to_bytes(decoded, codeword_bytes) == codeword,
+                  "m=" << int(parameters.m) << " t=" << parameters.t << " length=" << code.code_length() << " word " << i
+                  << " with " << i % (parameters.t + 1) << " errors didn't decode");
+        }
+    }
+    return true;
+}
+
+//encode_batch and decode_batch match encode and decode, for counts on both sides of the scalar thresholds.
+static bool test_batch() {
+    std::mt19937 random(2);
+    for(const code_parameters& parameters : codes_) {
+        BCH code(GaloisField(parameters.m), parameters.t, parameters.length);
+        const uint32_t message_bytes = (code.message_length() + 7) / 8;
+        const uint32_t codeword_bytes = (code.code_length() + 7) / 8;
+        for(std::size_t count : {1u, 5u, 8u, 63u, 64u, 300u}) {
+            std::vector<uint8_t> messages = random_messages(code, random, count);
+            std::vector<uint8_t> codewords(count * codeword_bytes);
+            code.encode_batch(messages.data(), count, codewords.data());
+            //Up to t + 2 errors, so some words can't be decoded and both sides have to agree on that too.
+            std::vector<uint8_t> received = codewords;
+            for(std::size_t i = 0; i < count; ++i) {
+                add_errors(code, random, random() % (parameters.t + 3), received.data() + i * codeword_bytes);
+            }
+            std::vector<uint8_t> corrected(received.size()), failed(count);
+            code.decode_batch(received.data(), count, corrected.data(), failed.data());
+            for(std::size_t i = 0; i < count; ++i) {
+                BitVector message(messages.begin() + i * message_bytes, messages.begin() + (i + 1) * message_bytes);
+                std::vector<uint8_t> expected = to_bytes(code.encode(message), codeword_bytes);
+                CHECK(std::equal(expected.begin(), expected.end(), codewords.begin() + i * codeword_bytes),
+                      "m=" << int(parameters.m) << " t=" << parameters.t << " encode_batch(" << count << ") differs at " << i);
+                const uint8_t* word = received.data() + i * codeword_bytes;
+                uint8_t err = 0;
+                std::vector<uint8_t> decoded = to_bytes(code.decode(BitVector(word, word + codeword_bytes), &err), codeword_bytes);
+                CHECK(err == failed[i] && std::equal(decoded.begin(), decoded.end(), corrected.begin() + i * codeword_bytes),
+                      "m=" << int(parameters.m) << " t=" << parameters.t << " decode_batch(" << count << ") differs at " << i);
+            }
+        }
+    }
+    //Codes longer than the field or without message bits are invalid: batches report it instead of leaving the
+    //output unwritten.
+    for(const BCH& code : {BCH(GaloisField(4), 1, 16), BCH(GaloisField(5), 10, 20)}) {
+        const uint32_t codeword_bytes = (code.code_length() + 7) / 8;
+        std::vector<uint8_t> messages(64, 0xFF), codewords(4 * codeword_bytes, 0xFF), corrected(codewords.size()), failed(4);
+        uint8_t err = 0;
+        code.encode_batch(messages.data(), 4, codewords.data(), &err);
+        CHECK(!code && err && std::all_of(codewords.begin(), codewords.end(), [](uint8_t byte) { return !byte; }),
+              "invalid code of length " << code.code_length() << " encoded");
+        code.decode_batch(codewords.data(), 4, corrected.data(), failed.data());
+        CHECK(std::all_of(failed.begin(), failed.end(), [](uint8_t byte) { return byte; }),
+              "invalid code of length " << code.code_length() << " decoded");
+    }
+    return true;
+}
+
+//A saved cache loads back into an empty one and then builds the same codes without computing anything. Truncated
+//files and corrupted polynomials are rejected.
+static bool test_cache() {
+    const std::string path = "tests_cache.bin";
+    PolynomialCache& cache = PolynomialCache::instance();
+    cache.clear();
+    std::vector<BitVector> generators;
+    for(const code_parameters& parameters : codes_) {
+        generators.push_back(BCH(GaloisField(parameters.m), parameters.t).generator_polynomial());
+    }
+    CHECK(cache.modified() && cache.save(path) && !cache.modified(), "couldn't save " << path);
+    std::vector<uint8_t> saved;
+    {
+        MappedFile file(path);
+        CHECK(file, "couldn't read " << path);
+        saved.assign(file.data(), file.data() + file.size());
+    }
+    cache.clear();
+    CHECK(cache.load(path), "couldn't load " << path);
+    for(std::size_t i = 0; i < generators.size(); ++i) {
+        BCH code(GaloisField(codes_[i].m), codes_[i].t);
+        CHECK(!cache.modified() && code.generator_polynomial() == generators[i],
+              "m=" << int(codes_[i].m) << " t=" << codes_[i].t << " wasn't loaded");
+    }
+    //The end of the file is the last generator, its very last byte holding the constant term. Byte 19 is in the
+    //first minimal polynomial.
+    for(std::size_t corrupted : {saved.size() - 1, saved.size() - 3, std::size_t(19)}) {
+        std::vector<uint8_t> bytes = saved;
+        bytes[corrupted] ^= 0x10;
+        CHECK(write_file(path, bytes.data(), bytes.size()) && !cache.load(path), "cache corrupted at " << corrupted << " loaded");
+    }
+    CHECK(write_file(path, saved.data(), saved.size() - 1) && !cache.load(path), "truncated cache loaded");
+    std::remove(path.c_str());
+    return true;
+}
+
+//RFC 8439 appendix A.1: with a 64 bit counter and stream number, stream s is the 96 bit nonce 0 || s.
+static bool test_chacha20() {
+    struct vector {
+        uint8_t key_byte;
+        uint8_t key_value;
+        uint64_t stream;
+        uint32_t block;
+        uint8_t keystream[64];
+    };
+    static const vector vectors[] = {
+        {0, 0, 0, 0, {0x76, 0xb8, 0xe0, 0xad, 0xa0, 0xf1, 0x3d, 0x90, 0x40, 0x5d, 0x6a, 0xe5, 0x53, 0x86, 0xbd, 0x28,
+                      0xbd, 0xd2, 0x19, 0xb8, 0xa0, 0x8d, 0xed, 0x1a, 0xa8, 0x36, 0xef, 0xcc, 0x8b, 0x77, 0x0d, 0xc7,
+                      0xda, 0x41, 0x59, 0x7c, 0x51, 0x57, 0x48, 0x8d, 0x77, 0x24, 0xe0, 0x3f, 0xb8, 0xd8, 0x4a, 0x37,
+                      0x6a, 0x43, 0xb8, 0xf4, 0x15, 0x18, 0xa1, 0x1c, 0xc3, 0x87, 0xb6, 0x69, 0xb2, 0xee, 0x65, 0x86}},
+        {0, 0, 0, 1, {0x9f, 0x07, 0xe7, 0xbe, 0x55, 0x51, 0x38, 0x7a, 0x98, 0xba, 0x97, 0x7c, 0x73, 0x2d, 0x08, 0x0d,
+                      0xcb, 0x0f, 0x29, 0xa0, 0x48, 0xe3, 0x65, 0x69, 0x12, 0xc6, 0x53, 0x3e, 0x32, 0xee, 0x7a, 0xed,
+                      0x29, 0xb7, 0x21, 0x76, 0x9c, 0xe6, 0x4e, 0x43, 0xd5, 0x71, 0x33, 0xb0, 0x74, 0xd8, 0x39, 0xd5,
+                      0x31, 0xed, 0x1f, 0x28, 0x51, 0x0a, 0xfb, 0x45, 0xac, 0xe1, 0x0a, 0x1f, 0x4b, 0x79, 0x4d, 0x6f}},
+        {31, 1, 0, 1, {0x3a, 0xeb, 0x52, 0x24, 0xec, 0xf8, 0x49, 0x92, 0x9b, 0x9d, 0x82, 0x8d, 0xb1, 0xce, 0xd4, 0xdd,
+                       0x83, 0x20, 0x25, 0xe8, 0x01, 0x8b, 0x81, 0x60, 0xb8, 0x22, 0x84, 0xf3, 0xc9, 0x49, 0xaa, 0x5a,
+                       0x8e, 0xca, 0x00, 0xbb, 0xb4, 0xa7, 0x3b, 0xda, 0xd1, 0x92, 0xb5, 0xc4, 0x2f, 0x73, 0xf2, 0xfd,
+                       0x4e, 0x27, 0x36, 0x44, 0xc8, 0xb3, 0x61, 0x25, 0xa6, 0x4a, 0xdd, 0xeb, 0x00, 0x6c, 0x13, 0xa0}},
+        {1, 0xff, 0, 2, {0x72, 0xd5, 0x4d, 0xfb, 0xf1, 0x2e, 0xc4, 0x4b, 0x36, 0x26, 0x92, 0xdf, 0x94, 0x13, 0x7f, 0x32,
+                         0x8f, 0xea, 0x8d, 0xa7, 0x39, 0x90, 0x26, 0x5e, 0xc1, 0xbb, 0xbe, 0xa1, 0xae, 0x9a, 0xf0, 0xca,
+                         0x13, 0xb2, 0x5a, 0xa2, 0x6c, 0xb4, 0xa6, 0x48, 0xcb, 0x9b, 0x9d, 0x1b, 0xe6, 0x5b, 0x2c, 0x09,
+                         0x24, 0xa6, 0x6c, 0x54, 0xd5, 0x45, 0xec, 0x1b, 0x73, 0x74, 0xf4, 0x87, 0x2e, 0x99, 0xf0, 0x96}},
+        {0, 0, uint64_t(0x02000000) << 32, 0,
+                     {0xc2, 0xc6, 0x4d, 0x37, 0x8c, 0xd5, 0x36, 0x37, 0x4a, 0xe2, 0x04, 0xb9, 0xef, 0x93, 0x3f, 0xcd,
+                      0x1a, 0x8b, 0x22, 0x88, 0xb3, 0xdf, 0xa4, 0x96, 0x72, 0xab, 0x76, 0x5b, 0x54, 0xee, 0x27, 0xc7,
+                      0x8a, 0x97, 0x0e, 0x0e, 0x95, 0x5c, 0x14, 0xf3, 0xa8, 0x8e, 0x74, 0x1b, 0x97, 0xc2, 0x86, 0xf7,
+                      0x5f, 0x8f, 0xc2, 0x99, 0xe8, 0x14, 0x83, 0x62, 0xfa, 0x19, 0x8a, 0x39, 0x53, 0x1b, 0xed, 0x6d}}
+    };
+    //Kernels go from slowest to fastest, so the one picked at startup is left in place.
+    for(ChaCha20::kernel kernel : {ChaCha20::kernel::scalar, ChaCha20::kernel::sse2}) {
+        if(!ChaCha20::set_kernel(kernel)) {
+            continue;
+        }
+        for(std::size_t v = 0; v < sizeof(vectors) / sizeof(vectors[0]); ++v) {
+            //Key bytes are read as little endian words.
+            uint32_t key[ChaCha20::key_words] = {};
+            key[vectors[v].key_byte / 4] = uint32_t(vectors[v].key_value) << (8 * (vectors[v].key_byte % 4));
+            std::vector<uint8_t> stream(64 * (vectors[v].block + 1));
+            ChaCha20(key, vectors[v].stream).fill(stream.data(), stream.size());
+            CHECK(std::equal(vectors[v].keystream, vectors[v].keystream + 64, stream.end() - 64),
+                  "kernel " << int(kernel) << " test vector " << v + 1 << " differs");
+        }
+        //Filling in pieces gives the same stream as filling at once, across the four block batches.
+        uint32_t key[ChaCha20::key_words] = {1, 2, 3, 4, 5, 6, 7, 8};
+        std::vector<uint8_t> whole(1000), pieces(1000);
+        ChaCha20(key, 9).fill(whole.data(), whole.size());
+        ChaCha20 generator(key, 9);
+        for(std::size_t done = 0, step = 1; done < pieces.size(); done += step, step = step * 3 % 97 + 1) {
+            generator.fill(pieces.data() + done, std::min(step, pieces.size() - done));
+        }
+        CHECK(whole == pieces, "kernel " << int(kernel) << " piecewise fill differs");
+    }
+    return true;
+}
+
+//A sketch built in parts of group_blocks blocks matches one built at once, and recovering it on a pool matches
+//recovering it serially, failed blocks included.
+static bool test_block_code() {
+    std::mt19937 random(5);
+    BCH bch(GaloisField(6), 2, 48);
+    BlockCode code(bch);
+    std::vector<uint8_t> input(5 * 2 * BlockCode::group_blocks + 3);
+    for(uint8_t& byte : input) {
+        byte = random();
+    }
+    const uint32_t blocks = code.blocks(input.size());
+    std::vector<uint8_t> messages = random_messages(bch, random, blocks);
+    std::vector<uint8_t> whole(code.sketch_bytes(input.size())), parts(whole.size());
+    code.sketches(input.data(), input.size(), 1, messages.data(), whole.data());
+    for(uint32_t first = 0; first < blocks; first += BlockCode::group_blocks) {
+        uint32_t count = blocks - first < BlockCode::group_blocks ? blocks - first : BlockCode::group_blocks;
+        code.sketch(input.data(), input.size(), first, count, messages.data() + std::size_t(first) * code.message_bytes(),
+                    parts.data() + std::size_t(first) * code.codeword_bytes());
+    }
+    CHECK(whole == parts, "sketch built in parts differs");
+    std::vector<uint8_t> noisy = input;
+    for(uint32_t e = 0; e < 2 * blocks; ++e) {
+        noisy[random() % noisy.size()] ^= 1 << (random() % 8);
+    }
+    std::vector<uint8_t> serial(input.size()), pooled(input.size()), serial_failed(blocks), pooled_failed(blocks, 2);
+    code.recover(whole.data(), noisy.data(), noisy.size(), 0, blocks, serial.data(), serial_failed.data());
+    ThreadPool pool(3);
+    code.recover(whole.data(), noisy.data(), noisy.size(), pooled.data(), pooled_failed.data(), pool);
+    CHECK(serial == pooled && serial_failed == pooled_failed, "recovery on a pool differs");
+    CHECK(std::count(serial_failed.begin(), serial_failed.end(), 0) > blocks / 2, "too few blocks recovered");
+    return true;
+}
+
+//Sketches written to a container read back unchanged and recover the input from a noisy reading.
+static bool test_container() {
+    std::mt19937 random(4);
+    const std::string path = "tests_container.bin";
+    BCH bch(GaloisField(8), 8, 200);
+    BlockCode code(bch);
+    std::vector<uint8_t> input(300);
+    for(uint8_t& byte : input) {
+        byte = random();
+    }
+    const uint64_t count = 5;
+    const uint32_t blocks = code.blocks(input.size());
+    const std::size_t sketch_bytes = code.sketch_bytes(input.size());
+    std::vector<uint8_t> messages = random_messages(bch, random, count * blocks);
+    std::vector<uint8_t> sketches(count * sketch_bytes);
+    code.sketches(input.data(), input.size(), count, messages.data(), sketches.data());
+    std::vector<uint8_t> header = SketchContainer::header(code, input.size(), count);
+    {
+        OutputFile file(path);
+        CHECK(file.write_at(0, header.data(), header.size()) && file.write_at(header.size(), sketches.data(), sketches.size())
+              && file.close(), "couldn't write " << path);
+    }
+    bool ok = true;
+    {
+        SketchContainer container(path);
+        ok = container && container.size() == count && container.input_bytes() == input.size() && container.blocks() == blocks
+             && container.sketch_bytes() == sketch_bytes && !container.sketch(count);
+        for(uint64_t i = 0; ok && i < count; ++i) {
+            ok = !std::memcmp(container.sketch(i), sketches.data() + i * sketch_bytes, sketch_bytes);
+            //A few bit errors per block are within t = 8.
+            std::vector<uint8_t> noisy = input, recovered(input.size()), failed(blocks);
+            for(uint32_t e = 0; e < 3 * blocks; ++e) {
+                noisy[random() % noisy.size()] ^= 1 << (random() % 8);
+            }
+            container.code().recover(container.sketch(i), noisy.data(), noisy.size(), 0, blocks, recovered.data(), failed.data());
+            ok = ok && recovered == input;
+        }
+    }
+    CHECK(ok, "container round trip failed");
+    //A data offset other than the end of the index, or an index entry before it, is rejected.
+    const uint64_t index_offset = header.size() - 8 * count;
+    for(std::size_t field : {std::size_t(56), std::size_t(index_offset)}) {
+        std::vector<uint8_t> tampered = header;
+        tampered[field] -= 8;
+        {
+            OutputFile file(path);
+            CHECK(file.write_at(0, tampered.data(), tampered.size()) && file.write_at(tampered.size(), sketches.data(), sketches.size())
+                  && file.close(), "couldn't write " << path);
+        }
+        CHECK(!SketchContainer(path), "container with a bad offset at byte " << field << " accepted");
+    }
+    std::remove(path.c_str());
+    return true;
+}
+
+#ifdef CLI_PATH
+//The CLI writes the same containers whatever the number of threads, for an input batched across sketches and
+//one split into parts within a sketch, and every sketch recovers the input.
+static bool test_cli() {
+    std::mt19937 random(9);
+    struct run {
+        std::size_t input_bytes;
+        const char* options;
+    };
+    for(const run& current : {run{40, "-s 700"}, run{600, "-m 4 -s 3"}}) {
+        const std::string input_path = "tests_cli_input.bin";
+        std::vector<uint8_t> input(current.input_bytes);
+        for(uint8_t& byte : input) {
+            byte = random();
+        }
+        CHECK(write_file(input_path, input.data(), input.size()), "couldn't write " << input_path);
+        std::vector<std::vector<uint8_t>> outputs;
+        for(const char* threads : {"1", "3", "8"}) {
+            const std::string output_path = std::string("tests_cli_") + threads + ".bin";
+            const std::string command = std::string("\"") + CLI_PATH + "\" -if " + input_path + " -of " + output_path + " -c --seed 11 "
+                                        + current.options + " -j " + threads;
+            CHECK(!std::system(command.c_str()), command << " failed");
+            SketchContainer container(output_path);
+            CHECK(container, command << " wrote an invalid container");
+            std::vector<uint8_t> recovered(input.size());
+            for(uint64_t i = 0; i < container.size(); ++i) {
+                container.code().recover(container.sketch(i), input.data(), input.size(), 0, container.blocks(), recovered.data());
+                CHECK(recovered == input, command << " sketch " << i << " doesn't recover the input");
+            }
+            MappedFile file(output_path);
+            outputs.emplace_back(file.data(), file.data() + file.size());
+            std::remove(output_path.c_str());
+            CHECK(outputs.back() == outputs.front(), command << " differs from -j 1");
+        }
+        std::remove(input_path.c_str());
+    }
+    return true;
+}
+#endif
+
+int main(int argc, char **argv) {
+    struct test {
+        const char* name;
+        bool (*run)();
+    };
+    static const test tests[] = {
+        {"clmul", test_clmul}, {"gf_bulk", test_gf_bulk}, {"static", test_static}, {"round_trip", test_round_trip},
+        {"batch", test_batch}, {"cache", test_cache}, {"chacha20", test_chacha20}, {"block_code", test_block_code},
+        {"container", test_container},
+#ifdef CLI_PATH
+        {"cli", test_cli}
+#endif
+    };
+    bool passed = true;
+    for(const test& current : tests) {
+        bool selected = argc < 2;
+        for(int i = 1; i < argc; ++i) {
+            selected = selected || current.name == std::string(argv[i]);
+        }
+        if(selected && !current.run()) {
+            std::cerr << current.name << " failed" << std::endl;
+            passed = false;
+        }
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,120 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "threadpool.h"
+
+ThreadPool::ThreadPool(uint32_t threads): queued_(0), next_queue_(0), pending_(0), stop_(false) {
+    if(!threads) {
+        threads = 1;
+    }
+    for(uint32_t i = 0; i < threads; ++i) {
+        queues_.emplace_back(new queue_());
+    }
+    for(uint32_t i = 0; i < threads; ++i) {
+        threads_.emplace_back(&ThreadPool::run_, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_available_.notify_all();
+    for(std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(task work) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++pending_;
+    }
+    queue_& queue = *queues_[next_queue_++ % queues_.size()];
+    {
+        //Counted only once it can be taken, and under the same lock take_ uncounts it with, so a worker woken by
+        //queued_ always finds the task instead of spinning on empty queues.
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(work));
+        ++queued_;
+    }
+    //Taking the lock orders the notification after a worker's check of queued_, so the wake up can't be lost.
+    std::lock_guard<std::mutex> lock(mutex_);
+    work_available_.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this]() { return !pending_; });
+}
+
+uint32_t ThreadPool::size() const {
+    return threads_.size();
+}
+
+uint32_t ThreadPool::hardware_threads() {
+    uint32_t ret = std::thread::hardware_concurrency();
+    return ret ? ret : 1;
+}
+
+void ThreadPool::run_(uint32_t worker) {
+    task work;
+    while(true) {
+        if(take_(worker, work)) {
+            work(worker);
+            work = nullptr;
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(!--pending_) {
+                idle_.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        work_available_.wait(lock, [this]() { return stop_ || queued_; });
+        if(stop_ && !queued_) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::take_(uint32_t worker, task& work) {
+    const uint32_t count = queues_.size();
+    for(uint32_t i = 0; i < count; ++i) {
+        queue_& queue = *queues_[(worker + i) % count];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.tasks.empty()) {
+            continue;
+        }
+        //Own work is taken oldest first, so results come out roughly in submission order. Thieves take
+        //from the other end.
+        if(!i) {
+            work = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        else {
+            work = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        --queued_;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,82 @@
+/*
+ * <one line to give the program's name and a brief idea of what it does.>
+ * Copyright (C) 2018  <copyright holder> <email>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed size pool of worker threads. Each worker has its own task queue: it runs tasks from the front of its
+ * queue and, once that is empty, steals from the back of the others'. Tasks receive the index of the worker
+ * running them, so per-worker state can be kept in a vector indexed by it.
+ */
+class ThreadPool {
+public:
+    typedef std::function<void(uint32_t worker)> task;
+    
+    explicit ThreadPool(uint32_t threads);
+    
+    ThreadPool(const ThreadPool&) = delete;
+    
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    //Waits for the queued tasks to finish.
+    ~ThreadPool();
+    
+    void submit(task work);
+    
+    //Blocks until every submitted task has finished.
+    void wait();
+    
+    uint32_t size() const;
+    
+    //Number of hardware threads, at least 1.
+    static uint32_t hardware_threads();
+    
+private:
+    struct queue_ {
+        std::mutex mutex;
+        std::deque<task> tasks;
+    };
+    
+    std::vector<std::unique_ptr<queue_>> queues_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::condition_variable idle_;
+    std::atomic<uint32_t> queued_;
+    std::atomic<uint32_t> next_queue_;
+    uint32_t pending_;
+    bool stop_;
+    
+    void run_(uint32_t worker);
+    
+    bool take_(uint32_t worker, task& work);
+};
+
+#endif // THREADPOOL_H